@@ -0,0 +1,45 @@
+/*
+ * cancelToken.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "cancelToken.h"
+
+#include "exception.h"
+
+namespace LightCouch {
+
+CancelToken::CancelToken():cancelState(0),hasDeadline(false) {
+}
+
+CancelToken::CancelToken(natural timeout)
+	:cancelState(0),hasDeadline(true),deadline(Clock::now() + std::chrono::milliseconds(timeout)) {
+}
+
+void CancelToken::cancel() {
+	lockCompareExchange(cancelState,0,1);
+}
+
+bool CancelToken::isCanceled() const {
+	return cancelState != 0 || isExpired();
+}
+
+bool CancelToken::isExpired() const {
+	return hasDeadline && Clock::now() >= deadline;
+}
+
+natural CancelToken::getRemain() const {
+	if (!hasDeadline) return naturalNull;
+	Clock::time_point now = Clock::now();
+	if (now >= deadline) return 0;
+	return natural(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count());
+}
+
+void CancelToken::check() const {
+	if (cancelState != 0) throw CanceledException(THISLOCATION);
+	if (isExpired()) throw DeadlineExceededException(THISLOCATION);
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,70 @@
+/*
+ * cancelToken.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_CANCELTOKEN_H_
+#define LIGHTCOUCH_CANCELTOKEN_H_
+
+#include <chrono>
+#include <lightspeed/base/types.h>
+#include <lightspeed/mt/atomic.h>
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Allows to cancel the requests and to limit their duration
+/**
+ * Token is connected with the CouchDB instance for duration of the request (see CouchDB::CancelScope),
+ * or it is passed directly to the functions which accept it (Query::exec(), Changeset::commit()). While
+ * the connection waits for the data, the token is checked periodically. Once the token is canceled, or
+ * its deadline expires, the connection is closed and the request throws the CanceledException (or the
+ * DeadlineExceededException).
+ *
+ * Function cancel() can be called from any thread. One token can be shared by multiple requests and
+ * multiple connections, so the whole work can be abandoned at once.
+ */
+class CancelToken {
+public:
+
+	///Creates token without the deadline
+	CancelToken();
+	///Creates token with the deadline
+	/**
+	 * @param timeout time in milliseconds from now, when the token expires
+	 */
+	explicit CancelToken(natural timeout);
+
+	///Cancels all requests which are using this token
+	void cancel();
+	///Returns true when the token has been canceled or the deadline has expired
+	bool isCanceled() const;
+	///Returns true when the deadline has expired
+	bool isExpired() const;
+	///Returns time in milliseconds remaining to the deadline. Returns naturalNull, if there is no deadline
+	natural getRemain() const;
+	///Throws the exception if the token has been canceled
+	/**
+	 * @exception CanceledException token has been canceled
+	 * @exception DeadlineExceededException deadline has expired
+	 */
+	void check() const;
+
+protected:
+	typedef std::chrono::steady_clock Clock;
+
+	atomic cancelState;
+	bool hasDeadline;
+	Clock::time_point deadline;
+
+private:
+	CancelToken(const CancelToken &);
+	CancelToken &operator=(const CancelToken &);
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_CANCELTOKEN_H_ */
@@ -8,6 +8,7 @@
 #include "changeset.h"
 
 #include "document.h"
+#include "documentCache.h"
 
 #include "lightspeed/base/containers/autoArray.tcc"
 
@@ -66,16 +67,22 @@ Changeset& Changeset::commit(CouchDB& db,bool all_or_nothing) {
 
 
 	AutoArray<UpdateException::ErrorItem> errors;
+	Pointer<DocumentCache> docCache = db.getDocumentCache();
 
 	natural index = 0;
 	for (JSON::ConstIterator iter = out->getFwIter(); iter.hasItems();) {
 		const JSON::ConstKeyValue &kv = iter.getNext();
 
 		JSON::ConstValue rev = kv["rev"];
-		if (rev != null) json.object(docs[index])("_rev",rev);
+		if (rev != null) {
+			json.object(docs[index])("_rev",rev);
+			//write-through - store copy, because the document can be edited later
+			if (docCache != null) docCache->set(db.getCurrentDB(), docs[index]->copy(json.factory,naturalNull));
+		}
 
 		JSON::ConstValue err = kv["error"];
 		if (err != null) {
+			if (docCache != null) docCache->erase(db.getCurrentDB(), kv["id"].getStringA());
 			UpdateException::ErrorItem e;
 			e.errorDetails = kv;
 			e.document = docs[index];
@@ -133,6 +140,11 @@ Changeset& Changeset::commit(bool all_or_nothing) {
 	return commit(db,all_or_nothing);
 }
 
+Changeset& Changeset::commit(const CancelToken &token, bool all_or_nothing) {
+	CouchDB::CancelScope _(db, &token);
+	return commit(db,all_or_nothing);
+}
+
 Changeset& Changeset::erase(ConstValue docId, ConstValue revId) {
 	docs.add(json("_id",static_cast<const Value &>(docId))
 			("_rev",static_cast<const Value &>(revId))
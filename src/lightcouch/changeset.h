@@ -83,6 +83,16 @@ public:
 	 */
 	Changeset &commit(bool all_or_nothing=true);
 
+	///Commits all changes in the database, the request can be canceled
+	/**
+	 * @param token cancel token. When it is canceled or its deadline expires, the request is
+	 * aborted and the CanceledException is thrown. Note that server can apply the changes even
+	 * if the request has been canceled
+	 * @param all_or_nothing see commit()
+	 * @return reference to the Changeset to create chains
+	 */
+	Changeset &commit(const CancelToken &token, bool all_or_nothing=true);
+
 
 	///Preview all changes in a local view
 	/** Function just only sends all changes to a local view, without making the
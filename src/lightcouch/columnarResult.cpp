@@ -0,0 +1,344 @@
+/*
+ * columnarResult.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "columnarResult.h"
+
+#include <limits>
+#include "lightspeed/base/containers/autoArray.tcc"
+
+#include "couchDB.h"
+#include "jsonPull.h"
+#include "query.h"
+
+namespace LightCouch {
+
+ColumnarResult::Column::Column():type(typeNull),count(0) {
+}
+
+bool ColumnarResult::Column::isNull(natural row) const {
+	return type == typeNull || (row < nulls.size() && nulls[row]);
+}
+
+integer ColumnarResult::Column::getInt(natural row) const {
+	switch (type) {
+	case typeInt:
+	case typeBool: return intData[row];
+	case typeDouble: return integer(doubleData[row]);
+	default: return 0;
+	}
+}
+
+double ColumnarResult::Column::getDouble(natural row) const {
+	switch (type) {
+	case typeInt:
+	case typeBool: return double(intData[row]);
+	case typeDouble: return doubleData[row];
+	default: return 0;
+	}
+}
+
+bool ColumnarResult::Column::getBool(natural row) const {
+	switch (type) {
+	case typeInt:
+	case typeBool: return intData[row] != 0;
+	case typeDouble: return doubleData[row] != 0;
+	default: return false;
+	}
+}
+
+//nulls are stored as zeroes, so sum can run over the whole array
+double ColumnarResult::Column::sum() const {
+	if (type == typeDouble) {
+		double s = 0;
+		const double *d = doubleData.data();
+		for (natural i = 0, cnt = doubleData.size(); i < cnt; i++) s += d[i];
+		return s;
+	} else if (type == typeInt || type == typeBool) {
+		integer s = 0;
+		const integer *d = intData.data();
+		for (natural i = 0, cnt = intData.size(); i < cnt; i++) s += d[i];
+		return double(s);
+	} else {
+		return 0;
+	}
+}
+
+double ColumnarResult::Column::min() const {
+	double m = std::numeric_limits<double>::infinity();
+	if (type != typeDouble && type != typeInt && type != typeBool) return m;
+	for (natural i = 0; i < count; i++) {
+		if (isNull(i)) continue;
+		double v = getDouble(i);
+		if (v < m) m = v;
+	}
+	return m;
+}
+
+double ColumnarResult::Column::max() const {
+	double m = -std::numeric_limits<double>::infinity();
+	if (type != typeDouble && type != typeInt && type != typeBool) return m;
+	for (natural i = 0; i < count; i++) {
+		if (isNull(i)) continue;
+		double v = getDouble(i);
+		if (v > m) m = v;
+	}
+	return m;
+}
+
+ColumnarResult::ColumnarResult(const Json& json)
+	:json(json),rowCount(0),total(0),offset(0),keyArray(false) {
+}
+
+ColumnarResult::ColumnarResult(const Json& json, const Result& result)
+	:json(json),rowCount(0),total(result.getTotal()),offset(result.getOffset()),keyArray(false) {
+	for (natural i = 0, cnt = result->length(); i < cnt; i++) {
+		addRow(result[i]);
+	}
+}
+
+natural ColumnarResult::intern(ConstStrA str) {
+	std::string s(str.data(), str.length());
+	std::unordered_map<std::string, natural>::const_iterator iter = stringMap.find(s);
+	if (iter != stringMap.end()) return iter->second;
+	natural id = strings.size();
+	strings.push_back(s);
+	stringMap.insert(std::make_pair(s, id));
+	return id;
+}
+
+ConstStrA ColumnarResult::getString(natural stringId) const {
+	const std::string &s = strings[stringId];
+	return ConstStrA(s.data(), s.length());
+}
+
+ConstStrA ColumnarResult::getString(const Column& col, natural row) const {
+	if (col.type != typeString || col.isNull(row)) return ConstStrA();
+	return getString(col.stringData[row]);
+}
+
+ConstValue ColumnarResult::getJson(const Column& col, natural row) const {
+	if (col.isNull(row)) return json(null);
+	switch (col.type) {
+	case typeBool: return json(col.intData[row] != 0);
+	case typeInt: return json(col.intData[row]);
+	case typeDouble: return json(col.doubleData[row]);
+	case typeString: return json(getString(col.stringData[row]));
+	case typeJson: return col.jsonData[row];
+	default: return json(null);
+	}
+}
+
+ConstValue ColumnarResult::getKeyJson(natural row) const {
+	if (!keyArray) {
+		if (keys.empty()) return json(null);
+		return getJson(keys[0], row);
+	}
+	Container arr = json.array();
+	for (natural i = 0; i < keys.size(); i++) {
+		arr.add(getJson(keys[i], row));
+	}
+	return arr;
+}
+
+void ColumnarResult::setType(Column& col, Type t) {
+	if (col.type == t) return;
+	if (col.type == typeNull) {
+		//previous rows are nulls, they are stored as default values
+		switch (t) {
+		case typeBool:
+		case typeInt: col.intData.resize(col.count, 0);break;
+		case typeDouble: col.doubleData.resize(col.count, 0);break;
+		case typeString: col.stringData.resize(col.count, 0);break;
+		default: col.jsonData.resize(col.count);break;
+		}
+		col.nulls.resize(col.count, true);
+	} else if (col.type == typeInt && t == typeDouble) {
+		col.doubleData.assign(col.intData.begin(), col.intData.end());
+		std::vector<integer>().swap(col.intData);
+	} else if (t == typeJson) {
+		col.jsonData.reserve(col.count);
+		for (natural i = 0; i < col.count; i++) col.jsonData.push_back(getJson(col, i));
+		std::vector<integer>().swap(col.intData);
+		std::vector<double>().swap(col.doubleData);
+		std::vector<natural>().swap(col.stringData);
+	}
+	col.type = t;
+}
+
+void ColumnarResult::addNull(Column& col) {
+	if (col.nulls.size() < col.count) col.nulls.resize(col.count, false);
+	col.nulls.push_back(true);
+	switch (col.type) {
+	case typeBool:
+	case typeInt: col.intData.push_back(0);break;
+	case typeDouble: col.doubleData.push_back(0);break;
+	case typeString: col.stringData.push_back(0);break;
+	case typeJson: col.jsonData.push_back(json(null));break;
+	default: break;
+	}
+	col.count++;
+}
+
+static void markNotNull(std::vector<bool> &nulls) {
+	if (!nulls.empty()) nulls.push_back(false);
+}
+
+void ColumnarResult::addBool(Column& col, bool v) {
+	if (col.type == typeNull) setType(col, typeBool);
+	if (col.type == typeBool) col.intData.push_back(v?1:0);
+	else {
+		setType(col, typeJson);
+		col.jsonData.push_back(json(v));
+	}
+	markNotNull(col.nulls);
+	col.count++;
+}
+
+void ColumnarResult::addInt(Column& col, integer v) {
+	if (col.type == typeNull) setType(col, typeInt);
+	if (col.type == typeInt) col.intData.push_back(v);
+	else if (col.type == typeDouble) col.doubleData.push_back(double(v));
+	else {
+		setType(col, typeJson);
+		col.jsonData.push_back(json(v));
+	}
+	markNotNull(col.nulls);
+	col.count++;
+}
+
+void ColumnarResult::addDouble(Column& col, double v) {
+	if (col.type == typeNull || col.type == typeInt) setType(col, typeDouble);
+	if (col.type == typeDouble) col.doubleData.push_back(v);
+	else {
+		setType(col, typeJson);
+		col.jsonData.push_back(json(v));
+	}
+	markNotNull(col.nulls);
+	col.count++;
+}
+
+void ColumnarResult::addString(Column& col, ConstStrA v) {
+	if (col.type == typeNull) setType(col, typeString);
+	if (col.type == typeString) col.stringData.push_back(intern(v));
+	else {
+		setType(col, typeJson);
+		col.jsonData.push_back(json(v));
+	}
+	markNotNull(col.nulls);
+	col.count++;
+}
+
+void ColumnarResult::addJson(Column& col, const ConstValue& v) {
+	setType(col, typeJson);
+	col.jsonData.push_back(v);
+	markNotNull(col.nulls);
+	col.count++;
+}
+
+void ColumnarResult::addValue(Column& col, const ConstValue& v) {
+	if (v == null) {
+		addNull(col);
+		return;
+	}
+	switch (v->getType()) {
+	case JSON::ndNull: addNull(col);break;
+	case JSON::ndBool: addBool(col, v->getBool());break;
+	case JSON::ndInt: addInt(col, v->getInt());break;
+	case JSON::ndFloat: addDouble(col, v->getFloat());break;
+	case JSON::ndString: addString(col, v->getStringUtf8());break;
+	default: addJson(col, v);break;
+	}
+}
+
+void ColumnarResult::finishRow() {
+	rowCount++;
+	//fill missing fields by nulls
+	for (natural i = 0; i < keys.size(); i++) {
+		while (keys[i].count < rowCount) addNull(keys[i]);
+	}
+	while (value.count < rowCount) addNull(value);
+	while (ids.count < rowCount) addNull(ids);
+}
+
+void ColumnarResult::addRow(const ConstValue& row) {
+	const JSON::INode *k = row->getPtr("key");
+	if (k && k->getType() == JSON::ndArray) {
+		keyArray = true;
+		for (natural i = 0, cnt = k->length(); i < cnt; i++) {
+			if (i >= keys.size()) keys.resize(i+1);
+			while (keys[i].count < rowCount) addNull(keys[i]);
+			addValue(keys[i], row["key"][i]);
+		}
+	} else if (k) {
+		if (keys.empty()) keys.resize(1);
+		while (keys[0].count < rowCount) addNull(keys[0]);
+		addValue(keys[0], ConstValue(k));
+	}
+	const JSON::INode *v = row->getPtr("value");
+	if (v) addValue(value, ConstValue(v));
+	const JSON::INode *id = row->getPtr("id");
+	if (id) addValue(ids, ConstValue(id));
+	finishRow();
+}
+
+template<typename Parser, typename Token>
+void ColumnarResult::addToken(Column& col, Parser& p, Token t) {
+	switch (t) {
+	case Parser::tkNull: addNull(col);break;
+	case Parser::tkTrue: addBool(col, true);break;
+	case Parser::tkFalse: addBool(col, false);break;
+	case Parser::tkNumber:
+		if (p.isInteger()) addInt(col, p.getInt()); else addDouble(col, p.getNumber());
+		break;
+	case Parser::tkString: addString(col, p.getString());break;
+	default: addJson(col, p.parseValue(t, json));break;
+	}
+}
+
+ColumnarResult ColumnarResult::exec(const Query& q) {
+	typedef Query::RowParser Parser;
+
+	ColumnarResult res(q.json);
+	q.streamTokens(Query::RowTokenFn([&](Parser &p, Parser::Token r) {
+		if (r != Parser::tkBeginObject) throw ErrorMessageException(THISLOCATION,"Unexpected format of the row");
+		for (Parser::Token f = p.next(); f != Parser::tkEndObject; f = p.next()) {
+			if (f != Parser::tkString) throw ErrorMessageException(THISLOCATION,"Expected key in JSON object");
+			ConstStrA field = p.getString();
+			if (field == ConstStrA("key")) {
+				Parser::Token k = p.next();
+				if (k == Parser::tkBeginArray) {
+					res.keyArray = true;
+					natural idx = 0;
+					for (Parser::Token c = p.next(); c != Parser::tkEndArray; c = p.next(), idx++) {
+						if (idx >= res.keys.size()) res.keys.resize(idx+1);
+						while (res.keys[idx].count < res.rowCount) res.addNull(res.keys[idx]);
+						res.addToken(res.keys[idx], p, c);
+					}
+				} else {
+					if (res.keys.empty()) res.keys.resize(1);
+					while (res.keys[0].count < res.rowCount) res.addNull(res.keys[0]);
+					res.addToken(res.keys[0], p, k);
+				}
+			} else if (field == ConstStrA("value")) {
+				res.addToken(res.value, p, p.next());
+			} else if (field == ConstStrA("id")) {
+				res.addToken(res.ids, p, p.next());
+			} else {
+				p.skipValue(p.next());
+			}
+		}
+		res.finishRow();
+	}), Query::FieldTokenFn([&](Parser &p, ConstStrA name, Parser::Token v) {
+		if (name == ConstStrA("total_rows") && v == Parser::tkNumber) res.total = natural(p.getInt());
+		else if (name == ConstStrA("offset") && v == Parser::tkNumber) res.offset = natural(p.getInt());
+		else p.skipValue(v);
+	}));
+	if (res.total == 0) res.total = res.rowCount;
+	return res;
+}
+
+} /* namespace LightCouch */
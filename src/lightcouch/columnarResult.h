@@ -0,0 +1,200 @@
+/*
+ * columnarResult.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_COLUMNARRESULT_H_
+#define LIGHTCOUCH_COLUMNARRESULT_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lightspeed/base/containers/constStr.h"
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class Query;
+class Result;
+
+///Result of the query stored in columns
+/**
+ * Views which emit fixed-shape keys and scalar values, for example [date, region] -> number,
+ * can be stored without creating JSON value for every row. Every component of the key is stored
+ * in its own column, values are stored in another column and the document ids in the string column.
+ *
+ * Each column has a type, which is chosen by the stored values. Numbers are stored in the
+ * contiguous arrays of integers or doubles, strings are interned (the column contains indexes
+ * to the string pool of the result). Column which contains values of different types (or
+ * objects and arrays) is stored as array of JSON values.
+ *
+ * Aggregations, such as sum(), run over the contiguous arrays.
+ *
+ * @code
+ * q.from(20).to(40);
+ * ColumnarResult res = ColumnarResult::exec(q);
+ * double total = res.getValue().sum();
+ * for (natural i = 0; i < res.length(); i++) {
+ *    ConstStrA region = res.getString(res.getKey(1), i);
+ *    ...
+ * }
+ * @endcode
+ */
+class ColumnarResult {
+public:
+
+	enum Type {
+		///column contains only nulls
+		typeNull,
+		///column contains booleans
+		typeBool,
+		///column contains integers
+		typeInt,
+		///column contains numbers, at least one of them is not integer
+		typeDouble,
+		///column contains strings
+		typeString,
+		///column contains mixed types or containers
+		typeJson
+	};
+
+	///One column of the result
+	class Column {
+	public:
+		Column();
+		///Type of the column
+		Type getType() const {return type;}
+		///Count of rows
+		natural length() const {return count;}
+		///Returns true, if the value in the row is null (or the field is missing)
+		bool isNull(natural row) const;
+		///Retrieves integer (typeInt, typeDouble, typeBool). Other types returns 0
+		integer getInt(natural row) const;
+		///Retrieves number (typeInt, typeDouble, typeBool). Other types returns 0
+		double getDouble(natural row) const;
+		///Retrieves bool (typeBool). Numbers are converted. Other types returns false
+		bool getBool(natural row) const;
+
+		///Direct access to integers (typeInt and typeBool)
+		const std::vector<integer> &ints() const {return intData;}
+		///Direct access to doubles (typeDouble)
+		const std::vector<double> &doubles() const {return doubleData;}
+		///Direct access to indexes of the strings (typeString). See ColumnarResult::getString()
+		const std::vector<natural> &strings() const {return stringData;}
+
+		///Calculates sum of the numeric column. Nulls are counted as zero
+		double sum() const;
+		///Calculates minimum of the numeric column. Nulls are skipped
+		double min() const;
+		///Calculates maximum of the numeric column. Nulls are skipped
+		double max() const;
+
+	protected:
+		friend class ColumnarResult;
+
+		Type type;
+		natural count;
+		std::vector<integer> intData;
+		std::vector<double> doubleData;
+		std::vector<natural> stringData;
+		std::vector<ConstValue> jsonData;
+		///null flags, allocated once first null is stored
+		std::vector<bool> nulls;
+	};
+
+	///Creates empty result
+	/**
+	 * @param json json builder used to convert values
+	 */
+	ColumnarResult(const Json &json);
+
+	///Converts result to the columnar representation
+	/**
+	 * @param json json builder
+	 * @param result result
+	 */
+	ColumnarResult(const Json &json, const Result &result);
+
+	///Executes the query and stores the rows directly to the columns
+	/**
+	 * The response is parsed by the streaming parser, so JSON values are not created for the
+	 * rows. Only values which cannot be stored in the typed columns are created.
+	 *
+	 * @param q query
+	 * @return columnar result
+	 *
+	 * @note Postprocessing function of the view is not called
+	 */
+	static ColumnarResult exec(const Query &q);
+
+	///Adds row
+	/**
+	 * @param row row object (with fields id, key, value)
+	 */
+	void addRow(const ConstValue &row);
+
+	///Count of rows
+	natural length() const {return rowCount;}
+	///Count of columns of the key
+	/** If the key is not an array, there is one column */
+	natural getKeyCount() const {return keys.size();}
+	///Retrieves column of the key
+	const Column &getKey(natural index) const {return keys[index];}
+	///Retrieves column of values
+	const Column &getValue() const {return value;}
+	///Retrieves column of document ids
+	const Column &getIds() const {return ids;}
+	///Determines, whether keys are arrays
+	bool isKeyArray() const {return keyArray;}
+
+	///Retrieves interned string
+	ConstStrA getString(natural stringId) const;
+	///Retrieves string from the string column
+	ConstStrA getString(const Column &col, natural row) const;
+	///Retrieves value of the column as JSON
+	ConstValue getJson(const Column &col, natural row) const;
+	///Retrieves key of the row as JSON
+	/** If the keys have different count of components, missing components are returned as nulls */
+	ConstValue getKeyJson(natural row) const;
+
+	natural getTotal() const {return total;}
+	natural getOffset() const {return offset;}
+
+protected:
+
+	Json json;
+	std::vector<Column> keys;
+	Column value;
+	Column ids;
+	natural rowCount;
+	natural total;
+	natural offset;
+	bool keyArray;
+
+	std::vector<std::string> strings;
+	std::unordered_map<std::string, natural> stringMap;
+
+	natural intern(ConstStrA str);
+	void setType(Column &col, Type t);
+	void addNull(Column &col);
+	void addBool(Column &col, bool v);
+	void addInt(Column &col, integer v);
+	void addDouble(Column &col, double v);
+	void addString(Column &col, ConstStrA v);
+	void addJson(Column &col, const ConstValue &v);
+	void addValue(Column &col, const ConstValue &v);
+	void finishRow();
+
+	template<typename Parser, typename Token>
+	void addToken(Column &col, Parser &p, Token t);
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_COLUMNARRESULT_H_ */
@@ -17,6 +17,7 @@ namespace BredyHttpClient {
 namespace LightCouch {
 
 class QueryCache;
+class DocumentCache;
 class Validator;
 class IIDGen;
 
@@ -52,6 +53,15 @@ struct Config {
 	 * can reduce time by skipping data transfering and parsing
 	 */
 	Pointer<QueryCache> cache;
+	///Pointer to document cache
+	/** This pointer can be NULL to disable document caching. Otherwise, you have to
+	 * keep pointer valid until the CouchDB object is destroyed. DocumentCache can be shared
+	 * between many instances of CouchDB of the same server.
+	 *
+	 * Document cache is used by CouchDB::retrieveDocument(), it is updated by Changeset::commit() and
+	 * by the changes feed. See DocumentCache for details
+	 */
+	Pointer<DocumentCache> docCache;
 	///Pointer to object validator
 	/** Everytime anything is being put into database, validator is called. Failed
 	 * validation is thrown as exception.
@@ -6,6 +6,7 @@
  */
 
 
+#include <exception>
 #include "changeset.h"
 #include "couchDB.h"
 #include <lightspeed/base/containers/convertString.h>
@@ -33,6 +34,11 @@
 #include "conflictResolver.h"
 #include "defaultUIDGen.h"
 #include "queryCache.h"
+#include "documentCache.h"
+#include "projection.h"
+#include "cancelToken.h"
+#include "queryProfile.h"
+#include "lightspeed/mt/thread.h"
 
 #include "document.h"
 using LightSpeed::INetworkServices;
@@ -62,7 +68,7 @@ static JSON::PFactory createFactory(JSON::PFactory jfact) {
 
 CouchDB::CouchDB(const Config& cfg)
 	:json(createFactory(cfg.factory)),baseUrl(cfg.baseUrl),factory(json.factory)
-	,cache(cfg.cache),seqNumSlot(0)
+	,cache(cfg.cache),docCache(cfg.docCache),seqNumSlot(0),seqInvalidSlot(0),cancelToken(0),profile(0)
 	,uidGen(cfg.uidgen == null?DefaultUIDGen::getInstance():*cfg.uidgen)
 	,httpConfig(cfg),http(httpConfig)
 {
@@ -87,7 +93,111 @@ void CouchDB::reqPathToFullPath(ConstStrA reqPath, C &output) {
 
 
 
+///Connects the cancel token with the connection during the request
+/** Guard must be created after the lock is acquired. Call attach() after the request
+ * is opened and after it is sent, because the connection can be changed by the client.
+ */
+class CouchDB::CancelGuard {
+public:
+	CancelGuard(CouchDB &owner):owner(owner),handler(owner.cancelToken) {
+		if (owner.cancelToken) owner.cancelToken->check();
+	}
+	~CancelGuard() {
+		if (conn != null) conn->setWaitHandler(0);
+		//interrupted exchange leaves unread data in the connection, so it cannot be reused
+		if (handler.token && handler.token->isCanceled() && std::uncaught_exception()) {
+			try {owner.http.closeConnection();} catch (...) {}
+		}
+	}
+	void attach() {
+		if (handler.token == 0) return;
+		PNetworkStream c = owner.http.getConnection();
+		if (c != conn) {
+			if (conn != null) conn->setWaitHandler(0);
+			conn = c;
+			if (conn != null) conn->setWaitHandler(&handler);
+		}
+	}
+
+protected:
+	class Handler: public INetworkResource::WaitHandler {
+	public:
+		const CancelToken *token;
+
+		Handler(const CancelToken *token):token(token) {}
+		virtual natural wait(const INetworkResource *resource, natural waitFor, natural timeout) const {
+			Timeout limitTm(timeout);
+			for(;;) {
+				token->check();
+				//check the token each 200 ms, or sooner if the deadline is near
+				natural step = token->getRemain();
+				if (step > 200) step = 200;
+				natural r = INetworkResource::WaitHandler::wait(resource,waitFor,step);
+				if (r) return r;
+				if (timeout != naturalNull && limitTm.expired()) return 0;
+			}
+		}
+	};
+
+	CouchDB &owner;
+	Handler handler;
+	PNetworkStream conn;
+};
+
+CouchDB::CancelScope::CancelScope(CouchDB &db, const CancelToken *token)
+	:db(db),prevToken(db.setCancelToken(token)) {
+}
+
+CouchDB::CancelScope::~CancelScope() {
+	db.setCancelToken(prevToken);
+}
+
+const CancelToken *CouchDB::setCancelToken(const CancelToken *token) {
+	const CancelToken *prev = cancelToken;
+	cancelToken = token;
+	return prev;
+}
+
+JSON::Value CouchDB::parseResponse(SeqFileInput &in) {
+	try {
+		return factory->fromStream(in);
+	} catch (JSON::ParseError_t &e) {
+		//canceled exception can be stored in reason of ParseError_t exception
+		const Exception *r = e.getReason();
+		while (r) {
+			if (dynamic_cast<const CanceledException *>(r)) r->throwAgain(THISLOCATION);
+			r = r->getReason();
+		}
+		throw;
+	}
+}
+
+JSON::Value CouchDB::parseProfiled(SeqFileInput &in) {
+	QueryProfile::Stopwatch sw;
+	//body is read in blocks, the buffer is doubled when it is full
+	AutoArray<char> body;
+	body.resize(16384);
+	natural used = 0;
+	while (in.hasItems()) {
+		if (used == body.length()) body.resize(used * 2);
+		used += in.blockRead(body.data() + used, body.length() - used, false);
+	}
+	profile->transfer += sw.lap();
+	profile->bytes += used;
+	JSON::Value v = factory->fromString(ConstStrA(body.data(), used));
+	profile->parse += sw.lap();
+	return v;
+}
+
 JSON::ConstValue CouchDB::requestGET(ConstStrA path, JSON::Value headers, natural flags) {
+	return cachedGET(path, 0, headers, flags);
+}
+
+JSON::ConstValue CouchDB::requestGET(ConstStrA path, const View::CachePolicy &policy, JSON::Value headers, natural flags) {
+	return cachedGET(path, &policy, headers, flags);
+}
+
+JSON::ConstValue CouchDB::cachedGET(ConstStrA path, const View::CachePolicy *policy, JSON::Value headers, natural flags) {
 	if (headers != null && headers->getType() != JSON::ndObject) {
 		throw InvalidParamException(THISLOCATION,4,"Argument headers must be either null or an JSON object");
 	}
@@ -101,17 +211,51 @@ JSON::ConstValue CouchDB::requestGET(ConstStrA path, JSON::Value headers, natura
 
 	//there will be stored cached item
 	Optional<QueryCache::CachedItem> cachedItem;
+	QueryProfile::Stopwatch sw;
+	auto profileHit = [&] {
+		if (profile) {
+			profile->cacheLookup += sw.lap();
+			profile->cacheHits++;
+		}
+	};
 
+	//relative paths of different databases are the same, the database must be part of the key
+	StringA cacheKey;
 	if (usecache) {
-		cachedItem = cache->find(path);
-		if (cachedItem->isDefined()) {
-			if (seqNumSlot && *seqNumSlot == cachedItem->seqNum && (flags & flgRefreshCache) == 0)
-				return cachedItem->value;
+		cache->recordAccess(database, path);
+		cacheKey = database + ConstStrA('/') + path;
+		QueryCache::CachedItem itm = cache->find(cacheKey);
+		if (itm.isDefined()) {
+			if (policy && policy->ttl && !itm.notFound && (flags & flgRefreshCache) == 0
+					&& QueryCache::getTime() - itm.storedTime < policy->ttl) {
+				cache->reportHit(path);
+				profileHit();
+				return itm.value;
+			}
+			if (seqNumSlot && (flags & flgRefreshCache) == 0) {
+				if (*seqNumSlot == itm.seqNum) {
+					cache->reportHit(path);
+					profileHit();
+					if (itm.notFound)
+						throw RequestError(THISLOCATION,requestUrl,404,"Not Found",static_cast<const Value &>(itm.value));
+					return itm.value;
+				}
+				if (seqInvalidSlot) lockInc(*seqInvalidSlot);
+			}
+			//negative item cannot be revalidated using ETag
+			if (!itm.notFound) cachedItem = itm;
 		}
 	}
 
+	if (profile) profile->cacheLookup += sw.lap();
 	Synchronized<FastLock> _(lock);
+	if (profile) {
+		profile->connectionWait += sw.lap();
+		profile->requests++;
+	}
+	CancelGuard cancelGuard(*this);
 	http.open(HttpClient::mGET, requestUrl);
+	cancelGuard.attach();
 	bool redirectRetry = false;
 	SeqFileInput response(NULL);
     do {
@@ -125,9 +269,38 @@ JSON::ConstValue CouchDB::requestGET(ConstStrA path, JSON::Value headers, natura
 			return false;
 		}));
 
-		response = http.send();
+		if (policy && policy->staleTolerance && cachedItem != null) {
+			//stale item can be returned when the server is not available
+			natural age = QueryCache::getTime() - cachedItem->storedTime;
+			bool canBeStale = age < policy->ttl + policy->staleTolerance;
+			try {
+				response = http.send();
+			} catch (const CanceledException &) {
+				//the caller doesn't want the result anymore, the stale result is not an answer
+				throw;
+			} catch (const Exception &) {
+				if (!canBeStale) throw;
+				http.closeConnection();
+				cache->reportHit(path);
+				return cachedItem->value;
+			}
+			if (canBeStale && http.getStatus() >= 500) {
+				http.close();
+				cache->reportHit(path);
+				return cachedItem->value;
+			}
+		} else {
+			response = http.send();
+		}
+		cancelGuard.attach();
 		if (http.getStatus() == 304 && cachedItem != null) {
 			http.close();
+			cache->touch(cacheKey);
+			cache->reportRevalidation(path);
+			if (profile) {
+				profile->firstByte += sw.lap();
+				profile->cacheHits++;
+			}
 			return cachedItem->value;
 		}
 		if (http.getStatus() == 301 || http.getStatus() == 302 || http.getStatus() == 303 || http.getStatus() == 307) {
@@ -139,6 +312,7 @@ JSON::ConstValue CouchDB::requestGET(ConstStrA path, JSON::Value headers, natura
 		}
     }
 	while (redirectRetry);
+	if (profile) profile->firstByte += sw.lap();
 
 	if (http.getStatus()/100 != 2) {
 
@@ -150,20 +324,35 @@ JSON::ConstValue CouchDB::requestGET(ConstStrA path, JSON::Value headers, natura
 			//There is limit to repeat max 31x, then return error
 			if (errorVal["error"].getStringA() == "try_again" && (flags & flgTryAgainCounterMask) != flgTryAgainCounterMask) {
 				SyncReleased<FastLock> _(lock);
-				return requestGET(path, headers, flags + flgTryAgainCounterStep);
+				return cachedGET(path, policy, headers, flags + flgTryAgainCounterStep);
 			}
 		} catch (...) {
 
 		}
 		http.close();
+		if (http.getStatus() == 404 && usecache && seqNumSlot && cache->isNegativeCachingEnabled()) {
+			cache->reportMiss(path);
+			cache->set(cacheKey, QueryCache::CachedItem::notFoundItem(*seqNumSlot,
+					errorVal == null?JSON::Value(json.object()):errorVal), QueryCache::categorize(path));
+		}
 		throw RequestError(THISLOCATION,requestUrl,http.getStatus(), http.getStatusMessage(), errorVal);
 	} else {
-		JSON::Value v = factory->fromStream(response);
+		JSON::Value v = profile?parseProfiled(response):parseResponse(response);
 		if (usecache) {
+			cache->reportMiss(path);
 			BredyHttpSrv::HeaderValue fld = http.getHeader(HttpClient::fldETag);
 			if (fld.defined) {
 				atomicValue useq = seqNumSlot?*seqNumSlot:0;
-				cache->set(path, QueryCache::CachedItem(fld,useq, v));
+				QueryCache::CachedItem itm(fld,useq, v);
+				bool admit = true;
+				if (policy) {
+					itm.priority = policy->priority;
+					if (policy->maxSize != naturalNull) {
+						itm.size = QueryCache::estimateSize(v);
+						admit = itm.size <= policy->maxSize;
+					}
+				}
+				if (admit) cache->set(cacheKey, itm, QueryCache::categorize(path));
 			}
 		}
 		if (flags & flgStoreHeaders && headers != null) {
@@ -188,7 +377,9 @@ JSON::ConstValue CouchDB::requestDELETE(ConstStrA path, JSON::Value headers, nat
 	reqPathToFullPath(path,requestUrl);
 
 	Synchronized<FastLock> _(lock);
+	CancelGuard cancelGuard(*this);
 	http.open(HttpClient::mDELETE, requestUrl);
+	cancelGuard.attach();
 	http.setHeader(HttpClient::fldAccept,"application/json");
 	if (headers) headers->enumEntries(JSON::IEntryEnum::lambda([this](const JSON::INode *nd, ConstStrA key, natural ){
 		this->http.setHeader(key,nd->getStringUtf8());
@@ -196,6 +387,7 @@ JSON::ConstValue CouchDB::requestDELETE(ConstStrA path, JSON::Value headers, nat
 	}));
 
 	SeqFileInput response = http.send();
+	cancelGuard.attach();
 	if (http.getStatus()/100 != 2) {
 
 		JSON::Value errorVal;
@@ -207,7 +399,7 @@ JSON::ConstValue CouchDB::requestDELETE(ConstStrA path, JSON::Value headers, nat
 		http.close();
 		throw RequestError(THISLOCATION,requestUrl,http.getStatus(), http.getStatusMessage(), errorVal);
 	} else {
-		JSON::Value v = factory->fromStream(response);
+		JSON::Value v = parseResponse(response);
 		if (flags & flgStoreHeaders && headers != null) {
 			headers->clear();
 			http.enumHeaders([&](ConstStrA key, ConstStrA value) {
@@ -228,8 +420,15 @@ JSON::ConstValue CouchDB::jsonPUTPOST(HttpClient::Method method, ConstStrA path,
 	AutoArray<char, SmallAlloc<4096> > requestUrl;
 	reqPathToFullPath(path,requestUrl);
 
+	QueryProfile::Stopwatch sw;
 	Synchronized<FastLock> _(lock);
+	if (profile) {
+		profile->connectionWait += sw.lap();
+		profile->requests++;
+	}
+	CancelGuard cancelGuard(*this);
 	http.open(method, requestUrl);
+	cancelGuard.attach();
 	http.setHeader(HttpClient::fldAccept,"application/json");
 	http.setHeader(HttpClient::fldContentType,"application/json");
 	if (headers != null) headers->enumEntries(JSON::IEntryEnum::lambda([this](const JSON::INode *nd, ConstStrA key, natural ){
@@ -243,6 +442,8 @@ JSON::ConstValue CouchDB::jsonPUTPOST(HttpClient::Method method, ConstStrA path,
 		JSON::serialize(data,textout,true);
 	}
 	SeqFileInput response = http.send();
+	cancelGuard.attach();
+	if (profile) profile->firstByte += sw.lap();
 	if (http.getStatus()/100 != 2) {
 
 		JSON::Value errorVal;
@@ -261,7 +462,7 @@ JSON::ConstValue CouchDB::jsonPUTPOST(HttpClient::Method method, ConstStrA path,
 		http.close();
 		throw RequestError(THISLOCATION,requestUrl,http.getStatus(), http.getStatusMessage(), errorVal);
 	} else {
-		JSON::Value v = factory->fromStream(response);
+		JSON::Value v = profile?parseProfiled(response):parseResponse(response);
 		if (flags & flgStoreHeaders && headers != null) {
 			headers.clear();
 			auto hb = json.object(headers);
@@ -276,6 +477,43 @@ JSON::ConstValue CouchDB::jsonPUTPOST(HttpClient::Method method, ConstStrA path,
 }
 
 
+void CouchDB::requestStream(ConstStrA path, JSON::ConstValue postData, const ResponseFn &responseFn) {
+	AutoArray<char, SmallAlloc<4096> > requestUrl;
+	reqPathToFullPath(path,requestUrl);
+
+	Synchronized<FastLock> _(lock);
+	CancelGuard cancelGuard(*this);
+	http.open(postData == null?HttpClient::mGET:HttpClient::mPOST, requestUrl);
+	cancelGuard.attach();
+	http.setHeader(HttpClient::fldAccept,"application/json");
+	if (postData != null) {
+		http.setHeader(HttpClient::fldContentType,"application/json");
+		SeqFileOutput out = http.beginBody(HttpClient::psoDefault);
+		SeqTextOutA textout(out);
+		JSON::serialize(postData,textout,true);
+	}
+	SeqFileInput response = http.send();
+	cancelGuard.attach();
+	if (http.getStatus()/100 != 2) {
+		JSON::Value errorVal;
+		try{
+			errorVal = factory->fromStream(response);
+		} catch (...) {
+
+		}
+		http.close();
+		throw RequestError(THISLOCATION,requestUrl,http.getStatus(), http.getStatusMessage(), errorVal);
+	}
+	try {
+		responseFn(response);
+	} catch (...) {
+		//response was not read completely, connection cannot be reused
+		http.closeConnection();
+		throw;
+	}
+	http.close();
+}
+
 JSON::ConstValue CouchDB::requestPUT(ConstStrA path, JSON::ConstValue postData, JSON::Container headers, natural flags) {
 	return jsonPUTPOST(HttpClient::mPUT,path,postData,headers,flags);
 }
@@ -287,6 +525,11 @@ JSON::ConstValue CouchDB::requestPOST(ConstStrA path, JSON::ConstValue postData,
 
 
 void CouchDB::use(ConstStrA database) {
+	if (database != this->database) {
+		//tracked sequence numbers belong to the previous database
+		seqNumSlot = 0;
+		seqInvalidSlot = 0;
+	}
 	this->database = database;
 }
 
@@ -302,6 +545,15 @@ void CouchDB::createDatabase() {
 	requestPUT(ConstStrA(),null);
 }
 
+void CouchDB::createDatabase(bool partitioned) {
+	requestPUT(partitioned?ConstStrA("?partitioned=true"):ConstStrA(),null);
+}
+
+ConstValue CouchDB::getPartitionInfo(ConstStrA partition) {
+	StringA path = ConstStrA("_partition/") + urlencode(partition);
+	return requestGET(path,null,flgDisableCache);
+}
+
 void CouchDB::deleteDatabase() {
 	requestDELETE(ConstStrA(),null);
 }
@@ -336,6 +588,7 @@ atomicValue& CouchDB::trackSeqNumbers() {
 	if (database.empty()) throw ErrorMessageException(THISLOCATION,"No current database");
 	atomicValue &v = cache->trackSeqNumbers(database);
 	if (v == 0) lockCompareExchange(v,0,getLastSeqNumber());
+	seqInvalidSlot = &cache->getSeqInvalidations(database);
 	seqNumSlot = &v;
 	return v;
 }
@@ -370,42 +623,85 @@ ConstValue CouchDB::retrieveDocument(ConstStrA docId, ConstStrA revId, natural f
 	return requestGET(urlLine.getArray(),null, flags & (flgDisableCache|flgRefreshCache));
 }
 
-ConstValue CouchDB::retrieveDocument(ConstStrA docId, natural flags) {
-	UrlLine urlLine;
+static void buildDocumentUrl(UrlLine &urlLine, ConstStrA docId, natural flags) {
 	TextOut<UrlLine &, SmallAlloc<256> > urlfmt(urlLine);
 	FilterRead<ConstStrA::Iterator, UrlEncoder> docIdEnc(docId.getFwIter());
 
 	urlfmt("%1") << &docIdEnc;
 
 	char c = '?';
-		char d = '&';
+	char d = '&';
 
-		if (flags & flgAttachments) {
-			urlfmt("%1attachments=true") << c;c=d;
-		}
-		if (flags & flgAttEncodingInfo) {
-			urlfmt("%1att_encoding_info=true") << c;c=d;
-		}
-		if (flags & flgConflicts) {
-			urlfmt("%1conflicts=true") << c;c=d;
-		}
-		if (flags & flgDeletedConflicts) {
-			urlfmt("%1deleted_conflicts=true") << c;c=d;
-		}
-		if (flags & flgSeqNumber) {
-			urlfmt("%1local_seq=true") << c;c=d;
-		}
-		if (flags & flgRevisions) {
-			urlfmt("%1revs=true") << c;c=d;
-		}
-		if (flags & flgRevisionsInfo) {
-			urlfmt("%1revs_info=true") << c;
+	if (flags & CouchDB::flgAttachments) {
+		urlfmt("%1attachments=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgAttEncodingInfo) {
+		urlfmt("%1att_encoding_info=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgConflicts) {
+		urlfmt("%1conflicts=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgDeletedConflicts) {
+		urlfmt("%1deleted_conflicts=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgSeqNumber) {
+		urlfmt("%1local_seq=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgRevisions) {
+		urlfmt("%1revs=true") << c;c=d;
+	}
+	if (flags & CouchDB::flgRevisionsInfo) {
+		urlfmt("%1revs_info=true") << c;
+	}
+}
+
+ConstValue CouchDB::retrieveDocument(ConstStrA docId, natural flags) {
+	bool usedoccache = docCache != null
+			&& (flags & ~(flgRefreshCache|flgTryAgainCounterMask)) == 0
+			&& !database.empty();
+	if (usedoccache && (flags & flgRefreshCache) == 0) {
+		DocumentCache::CachedDoc cdoc = docCache->find(database, docId);
+		if (cdoc.missing) {
+			//negative record is valid until the database changes
+			if (seqNumSlot && *seqNumSlot == cdoc.seqNum)
+				throw RequestError(THISLOCATION,docId,404,"Not Found",json("error","not_found")("reason","missing"));
+		} else if (cdoc.isDefined()) {
+			return cdoc.doc;
 		}
+	}
 
-	return requestGET(urlLine.getArray(),null,flags & (flgDisableCache|flgRefreshCache));
+	UrlLine urlLine;
+	buildDocumentUrl(urlLine, docId, flags);
+
+	if (!usedoccache)
+		return requestGET(urlLine.getArray(),null,flags & (flgDisableCache|flgRefreshCache));
+
+	try {
+		ConstValue doc = requestGET(urlLine.getArray(),null,flags & (flgDisableCache|flgRefreshCache));
+		docCache->set(database, doc);
+		return doc;
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() == 404 && seqNumSlot && docCache->isNegativeCachingEnabled())
+			docCache->setMissing(database, docId, *seqNumSlot);
+		throw;
+	}
 
 }
 
+ConstValue CouchDB::retrieveDocument(ConstStrA docId, const Projection &projection, natural flags) {
+	UrlLine urlLine;
+	buildDocumentUrl(urlLine, docId, flags);
+
+	//document without _id and _rev cannot be updated
+	Projection proj(projection);
+	proj.add("_id").add("_rev");
+	ConstValue doc;
+	requestStream(urlLine.getArray(), null, ResponseFn([&](SeqFileInput in) {
+		doc = proj.parse(in, json);
+	}));
+	return doc;
+}
+
 CouchDB::UpdateResult CouchDB::updateDoc(ConstStrA updateHandlerPath, ConstStrA documentId,
 		JSON::ConstValue arguments) {
 
@@ -431,6 +727,7 @@ CouchDB::UpdateResult CouchDB::updateDoc(ConstStrA updateHandlerPath, ConstStrA
 	}
 	JSON::Container h = json.object();
 	JSON::ConstValue v = requestPUT(urlline.getArray(), null, h, flgStoreHeaders);
+	if (docCache != null) docCache->erase(database, documentId);
 
 	StringA newRev;
 	const JSON::INode *n = h->getPtr("X-Couch-Update-NewRev");
@@ -484,11 +781,14 @@ StringA CouchDB::uploadAttachment(Document& document, ConstStrA attachmentName,C
 		FilterRead<ConstStrA::Iterator, UrlEncoder> revIdEnc(revId.getFwIter());
 		urlfmt("?rev=%1") << &revIdEnc;
 	}
+	CancelGuard cancelGuard(*this);
 	http.open(HttpClient::mPUT, urlline.getArray());
+	cancelGuard.attach();
 	http.setHeader(HttpClient::fldContentType, contentType);
 	SeqFileOutput out = http.beginBody(HttpClient::psoDefault);
 	updateFn(out);
 	SeqFileInput in = http.send();
+	cancelGuard.attach();
 	if (http.getStatus() != 201) {
 
 		JSON::Value errorVal;
@@ -500,8 +800,9 @@ StringA CouchDB::uploadAttachment(Document& document, ConstStrA attachmentName,C
 		http.close();
 		throw RequestError(THISLOCATION,urlline.getArray(),http.getStatus(), http.getStatusMessage(), errorVal);
 	} else {
-		JSON::Value v = factory->fromStream(in);
+		JSON::Value v = parseResponse(in);
 		http.close();
+		if (docCache != null) docCache->erase(database, documentId);
 		return v["rev"].getStringA();
 	}
 }
@@ -551,6 +852,22 @@ Value CouchDB::newDocument(ConstStrA prefix) {
 	return json("_id",genUID(prefix));
 }
 
+static StringA partitionPrefix(ConstStrA partition) {
+	if (partition.empty() || partition.head(1) == ConstStrA('_') || partition.find(':') != naturalNull)
+		throw InvalidParamException(THISLOCATION,1,"Partition key must not be empty, start with underscore or contain a colon");
+	return partition + ConstStrA(":");
+}
+
+ConstStrA CouchDB::genPartitionedUID(ConstStrA partition) {
+	return genUID(partitionPrefix(partition));
+}
+
+Value CouchDB::newPartitionedDocument(ConstStrA partition) {
+	StringA prefix = partitionPrefix(partition);
+	Synchronized<FastLock> _(lock);
+	return json("_id",genUID(prefix));
+}
+
 template<typename T>
 class DesignDocumentParse: public JSON::Parser<T> {
 public:
@@ -617,34 +934,37 @@ public:
 static const ConstStrA _designSlash("_design/");
 
 
+namespace {
 
-bool CouchDB::uploadDesignDocument(ConstValue content, DesignDocUpdateRule updateRule, ConstStrA name) {
+class DDResolver: public ConflictResolver {
+public:
+	DDResolver(CouchDB &db, bool attachments, CouchDB::DesignDocUpdateRule rule):
+		ConflictResolver(db,attachments),rule(rule) {}
 
+	virtual ConstValue resolveConflict(Document &doc, const Path &path,
+			const ConstValue &leftValue, const ConstValue &rightValue) {
 
-	class DDResolver: public ConflictResolver {
-	public:
-		DDResolver(CouchDB &db, bool attachments, DesignDocUpdateRule rule):
-			ConflictResolver(db,attachments),rule(rule) {}
+		switch (rule) {
+			case CouchDB::ddurMergeSkip: return leftValue;
+			case CouchDB::ddurMergeOverwrite: return rightValue;
+			default: return ConflictResolver::resolveConflict(doc,path,leftValue,rightValue);
+		}
+	}
+	virtual bool isEqual(const ConstValue &leftValue, const ConstValue &rightValue) {
+		Document doc(leftValue);
+		ConstValue res = ConflictResolver::makeDiffObject(doc,Path::root, leftValue, rightValue);
+		return res == null;
 
-		virtual ConstValue resolveConflict(Document &doc, const Path &path,
-				const ConstValue &leftValue, const ConstValue &rightValue) {
+	}
 
-			switch (rule) {
-				case ddurMergeSkip: return leftValue;
-				case ddurMergeOverwrite: return rightValue;
-				default: return ConflictResolver::resolveConflict(doc,path,leftValue,rightValue);
-			}
-		}
-		virtual bool isEqual(const ConstValue &leftValue, const ConstValue &rightValue) {
-			Document doc(leftValue);
-			ConstValue res = ConflictResolver::makeDiffObject(doc,Path::root, leftValue, rightValue);
-			return res == null;
+protected:
+	CouchDB::DesignDocUpdateRule rule;
+};
 
-		}
+}
+
+bool CouchDB::uploadDesignDocument(ConstValue content, DesignDocUpdateRule updateRule, ConstStrA name) {
 
-	protected:
-		DesignDocUpdateRule rule;
-	};
 
 	if (name.empty()) {
 		name = content["_id"].getStringA();
@@ -652,7 +972,7 @@ bool CouchDB::uploadDesignDocument(ConstValue content, DesignDocUpdateRule updat
 		AutoArray<char, SmallAlloc<256> > newName;
 		newName.append(_designSlash);
 		newName.append(name);
-		return uploadDesignDocument(content,updateRule,name);
+		return uploadDesignDocument(content,updateRule,ConstStrA(newName));
 	}
 
 	Changeset chset = createChangeset();
@@ -711,6 +1031,131 @@ bool CouchDB::uploadDesignDocument(ConstValue content, DesignDocUpdateRule updat
 
 }
 
+///Deletes the design document, a missing document is ignored
+static void eraseDesignDocument(CouchDB &db, ConstStrA name) {
+	try {
+		ConstValue ddoc = db.retrieveDocument(name, CouchDB::flgDisableCache);
+		Changeset chset = db.createChangeset();
+		chset.erase(ddoc["_id"], ddoc["_rev"]);
+		chset.commit(false);
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() != 404) throw;
+	}
+}
+
+///Checks, whether the task of _active_tasks belongs to the database
+/** CouchDB 2.0+ reports the shards, for example shards/00000000-1fffffff/dbname.1234567890 */
+static bool isTaskOfDatabase(ConstStrA taskDb, ConstStrA database) {
+	if (taskDb == database) return true;
+	StringA shard = ConstStrA('/') + database + ConstStrA('.');
+	return taskDb.find(shard) != naturalNull;
+}
+
+bool CouchDB::deployDesignDocument(ConstValue content, ConstStrA name, const DeployProgressFn &progressFn, natural pollInterval) {
+
+	if (name.empty()) name = content["_id"].getStringA();
+	StringA liveName = name.head(8) == _designSlash?StringA(name):StringA(_designSlash + name);
+	StringA stagingName = liveName + ConstStrA("-staging");
+
+	DeployProgress status;
+	status.stagingName = stagingName;
+	auto report = [&](DeployProgress::Phase phase, natural progress) {
+		if (progressFn) {
+			status.phase = phase;
+			status.progress = progress;
+			progressFn(status);
+		}
+	};
+
+	//the _id and _rev belong to the source document, they must not be copied to the targets
+	Value body = content->copy(json.factory,1);
+	body.unset("_id");
+	body.unset("_rev");
+
+	try {
+		Document live = retrieveDocument(liveName, flgDisableCache);
+		DDResolver resolver(*this,true,ddurOverwrite);
+		if (resolver.isEqual(live, body)) return false;
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() != 404) throw;
+	}
+
+	try {
+		report(DeployProgress::phaseUpload, 0);
+		uploadDesignDocument(body, ddurOverwrite, stagingName);
+
+		ConstValue views = body["views"];
+		if (views != null && views->getType() == JSON::ndObject && views->length() > 0) {
+			//all views of the design document share one index, so one view is enough to build it
+			JSON::ConstIterator iter = views->getFwConstIter();
+			StringA viewPath = stagingName + ConstStrA("/_view/") + iter.getNext().getStringKey();
+
+			report(DeployProgress::phaseIndexing, 0);
+			//starts the indexer without waiting for the result
+			Query trigger(createQuery(View(viewPath, View::updateAfter)));
+			trigger.limit(0);
+			trigger.exec();
+
+			//the indexer appears in _active_tasks with a delay. If it is not seen in few seconds,
+			//the index has been probably built already, the query below makes sure
+			natural idleLimit = 5000 / (pollInterval?pollInterval:1) + 1;
+			bool seen = false;
+			for(natural idle = 0;;) {
+				ConstValue tasks;
+				try {
+					tasks = requestGET("/_active_tasks", null, flgDisableCache);
+				} catch (HttpStatusException &) {
+					//tasks are not available (no admin permissions), wait for the query below
+					break;
+				}
+				natural count = 0, sum = 0;
+				for (natural i = 0, cnt = tasks->length(); i < cnt; i++) {
+					ConstValue t = tasks[i];
+					if (t["type"].getStringA() == "indexer"
+							&& t["design_document"].getStringA() == stagingName
+							&& isTaskOfDatabase(t["database"].getStringA(), database)) {
+						sum += t["progress"]->getUInt();
+						count++;
+					}
+				}
+				if (count) {
+					seen = true;
+					report(DeployProgress::phaseIndexing, sum / count);
+				} else if (seen || ++idle >= idleLimit) {
+					break;
+				}
+				if (cancelToken) cancelToken->check();
+				Thread::sleep(pollInterval);
+			}
+			//returns once the index is up to date
+			Query wait(createQuery(View(viewPath)));
+			wait.limit(0);
+			wait.exec();
+			report(DeployProgress::phaseIndexing, 100);
+		}
+
+		//same content has the same index signature, so the live document uses the index built above
+		report(DeployProgress::phaseSwap, 100);
+		uploadDesignDocument(body, ddurOverwrite, liveName);
+	} catch (...) {
+		//do not leave the staging document behind, it would keep its index alive
+		//the cleanup must not be stopped by the token, which has canceled the deployment
+		try {
+			CancelScope _(*this, 0);
+			eraseDesignDocument(*this, stagingName);
+		} catch (...) {
+
+		}
+		throw;
+	}
+
+	report(DeployProgress::phaseCleanup, 100);
+	eraseDesignDocument(*this, stagingName);
+
+	report(DeployProgress::phaseDone, 100);
+	return true;
+}
+
 template<typename T>
 JSON::Value parseDesignDocument(IIterator<char, T> &stream, JSON::PFactory factory) {
 	DesignDocumentParse<T> parser(stream, factory);
@@ -873,25 +1318,7 @@ Changes CouchDB::receiveChanges(ChangesSink& sink) {
 			conn->setWaitHandler(&whandle);
 
 		try {
-			v = factory->fromStream(in);
-		} catch (JSON::ParseError_t &e) {
-			//terminate http connection
-			http.closeConnection();
-			//canceled exception can be stored in reason of ParseError_t exception
-			const Exception *r = e.getReason();
-			//process all reasons
-			while (r) {
-				//test the reason
-				const CanceledException *ce = dynamic_cast<const CanceledException *>(r);
-				//throw reason only
-				if (ce) throw *ce;
-				//continue reading reasons
-				r = r->getReason();
-			}
-
-			//in case not found, throw what you have
-			throw;
-
+			v = parseResponse(in);
 		} catch (...) {
 			//any exception
 			//terminate connection
@@ -909,6 +1336,18 @@ Changes CouchDB::receiveChanges(ChangesSink& sink) {
 	ConstValue results=v["results"];
 	sink.seqNumber = v["last_seq"];
 	if (seqNumSlot) *seqNumSlot = sink.seqNumber;
+	if (docCache != null) {
+		for (JSON::ConstIterator iter = results->getFwConstIter(); iter.hasItems();) {
+			ChangedDoc chdoc(iter.getNext());
+			if (chdoc.deleted || chdoc.revisions == null || chdoc.revisions.length() != 1) {
+				docCache->erase(database, chdoc.id);
+			} else if (chdoc.doc != null) {
+				docCache->set(database, chdoc.doc);
+			} else {
+				docCache->update(database, chdoc.id, chdoc.revisions[0]["rev"].getStringA());
+			}
+		}
+	}
 
 	return results;
 }
@@ -934,9 +1373,12 @@ void CouchDB::downloadAttachment(const ConstStrA& documentId, const ConstStrA& r
 		FilterRead<ConstStrA::Iterator, UrlEncoder> revIdEnc(revId.getFwIter());
 		urlfmt("?rev=%1") << &revIdEnc;
 	}
+	CancelGuard cancelGuard(*this);
 	http.open(HttpClient::mGET, urlline.getArray());
+	cancelGuard.attach();
 	if (!etag.empty()) http.setHeader(http.fldIfNoneMatch,etag);
 	SeqFileInput in = http.send();
+	cancelGuard.attach();
 	natural status = http.getStatus();
 	if (status != 200 && status != 304) {
 
@@ -35,8 +35,12 @@ class UIDIterator;
 class Query;
 class Changeset;
 class QueryCache;
+class DocumentCache;
 class Conflicts;
 class Document;
+class Projection;
+class CancelToken;
+struct QueryProfile;
 class Validator;
 class Changes;
 class ChangesSink;
@@ -122,8 +126,21 @@ public:
 	 *    they will be deleted.
 	 * @param flags various flags that controls caching or behaviour
 	 * @return parsed response
+	 *
+	 * @exception RequestError request failed. If negative caching is enabled
+	 * (see QueryCache::enableNegativeCaching()), the status 404 can be reported directly from
+	 * the cache.
 	 */
 	JSON::ConstValue requestGET(ConstStrA path, JSON::Value headers = null, natural flags = 0);
+	///Perform GET request from the database applying the cache policy
+	/**
+	 * @param path absolute or relative path to the database. Absolute path must start with a slash '/'
+	 * @param policy cache policy applied to the request. See View::CachePolicy
+	 * @param headers optional argument, headers sent with the request as key-value structure.
+	 * @param flags various flags that controls caching or behaviour
+	 * @return parsed response
+	 */
+	JSON::ConstValue requestGET(ConstStrA path, const View::CachePolicy &policy, JSON::Value headers = null, natural flags = 0);
 	///Performs POST request from the database
 	/** POST request are not cached.
 	 *
@@ -205,6 +222,13 @@ public:
 
 
 	///Changes current database
+	/**
+	 * @param database name of the database.
+	 *
+	 * @note Switching to other database stops tracking of sequence numbers (see trackSeqNumbers()),
+	 * because the tracked numbers belong to the previous database. Call trackSeqNumbers() again
+	 * if needed.
+	 */
 	void use(ConstStrA database);
 	///Retrieves current database name
 	ConstStrA getCurrentDB() const;
@@ -216,6 +240,22 @@ public:
 	/** Creates database. Database is specified by function use()*/
 	void createDatabase();
 
+	///creates database
+	/** Creates database. Database is specified by function use()
+	 *
+	 * @param partitioned set true to create partitioned database (CouchDB 3.0+). Ids of
+	 * the documents in the partitioned database must be in the format "partition:docid". See
+	 * genPartitionedUID() and Query::partition()
+	 */
+	void createDatabase(bool partitioned);
+
+	///Retrieves informations about the partition
+	/**
+	 * @param partition partition key
+	 * @return response of the endpoint _partition/{partition} (doc_count, doc_del_count, sizes)
+	 */
+	ConstValue getPartitionInfo(ConstStrA partition);
+
 	///Deletes database
 	/** Deletes current database. Database is specified by function use */
 	void deleteDatabase();
@@ -272,6 +312,12 @@ public:
 	 */
 	atomicValue &trackSeqNumbers();
 
+	///Retrieves sequence number tracked by trackSeqNumbers()
+	/**
+	 * @return tracked sequence number, or zero, if sequence numbers are not tracked
+	 */
+	atomicValue getTrackedSeqNumber() const {return seqNumSlot?*seqNumSlot:0;}
+
 
 	///Retrieves local document (by its id)
 	/** You can use function to retrieve local document, because Query object will not retrieve it. To store
@@ -295,6 +341,12 @@ public:
 	 *
 	 * @note Retrieveing many documents using this method is slow. You should use Query
 	 * to retrieve multiple documents. However, some document properties are not available through the Query
+	 *
+	 * @note If DocumentCache is configured and no flags (except flgRefreshCache) are specified,
+	 * the document is returned from the DocumentCache. Flag flgDisableCache skips the DocumentCache,
+	 * flag flgRefreshCache forces to download the document and update the DocumentCache. The
+	 * DocumentCache also remembers missing documents, so repeated attempts to retrieve
+	 * non-existing document are reported without contacting the server.
 	 */
 	ConstValue retrieveDocument(ConstStrA docId, natural flags = 0);
 
@@ -308,6 +360,20 @@ public:
 	 */
 	ConstValue retrieveDocument(ConstStrA docId, ConstStrA revId, natural flags = flgDisableCache);
 
+	///Retrieves the document and keeps only selected fields
+	/**
+	 * The response is parsed by a streaming parser, unselected fields are skipped without
+	 * allocating them. Fields _id and _rev are always kept.
+	 *
+	 * @param docId document id
+	 * @param projection list of selected fields
+	 * @param flags flags, same as for the function retrieveDocument(). Flags related to caching are ignored.
+	 * @return json with the document
+	 *
+	 * @note Projected documents are not cached neither by the QueryCache nor by the DocumentCache.
+	 */
+	ConstValue retrieveDocument(ConstStrA docId, const Projection &projection, natural flags = 0);
+
 	///Creates new document
 	/**
 	 * Function creates new object and puts _id in it. Generates new id
@@ -323,6 +389,22 @@ public:
 	 */
 	Value newDocument(ConstStrA prefix);
 
+	///Creates new document in the partition
+	/**
+	 * Function creates new object and puts _id in it. The id has format "partition:uid", which
+	 * is required by the partitioned database.
+	 * @param partition partition key. It must not be empty, start with underscore or contain a colon
+	 * @return Value which can be converted to Document object
+	 */
+	Value newPartitionedDocument(ConstStrA partition);
+
+	///Generates new UID for the partitioned database
+	/**
+	 * @param partition partition key. It must not be empty, start with underscore or contain a colon
+	 * @return string reference to UID in format "partition:uid". See genUID() about the validity of the reference
+	 */
+	ConstStrA genPartitionedUID(ConstStrA partition);
+
 	///Creates empty document with specified ID
 	/**
 	 * @param id id of document
@@ -342,6 +424,12 @@ public:
 	 */
 	Pointer<Validator> getValidator() const {return validator;}
 
+	///Retrieves pointer to document cache
+	/**
+	 * @return function returns null, when document cache is not defined.
+	 */
+	Pointer<DocumentCache> getDocumentCache() const {return docCache;}
+
 	class UpdateResult: public ConstValue {
 	public:
 		UpdateResult(ConstValue v, StringA newRev):ConstValue(v),newRev(newRev) {}
@@ -437,6 +525,81 @@ public:
 
 	typedef Message<void, SeqFileOutput> UploadFn;
 	typedef Message<void, DownloadFile> DownloadFn;
+	typedef Message<void, SeqFileInput> ResponseFn;
+
+	///Performs request and passes the body of the response to the function as stream
+	/**
+	 * The response is not parsed and it is not cached. This allows to process large responses
+	 * by a streaming parser without building whole JSON in the memory.
+	 *
+	 * @param path absolute or relative path to the database. Absolute path must start with a slash '/'
+	 * @param postData if null, the GET request is performed. Otherwise the POST request is performed
+	 * and the data are sent in the body of the request.
+	 * @param responseFn function called with the stream of the response. The function is called only
+	 * if the status of the response is 2xx. Otherwise the RequestError is thrown.
+	 */
+	void requestStream(ConstStrA path, JSON::ConstValue postData, const ResponseFn &responseFn);
+
+	///Connects the cancel token with the connection for the lifetime of the object
+	/**
+	 * All requests performed by the connection inside of the scope are canceled when the token
+	 * is canceled or when its deadline expires. The previous token is restored when the scope ends.
+	 *
+	 * @code
+	 * CancelToken token(5000); //five seconds
+	 * {
+	 *    CouchDB::CancelScope _(db, &token);
+	 *    db.requestGET(...);
+	 *    db.downloadAttachment(...);
+	 * }
+	 * @endcode
+	 */
+	class CancelScope {
+	public:
+		CancelScope(CouchDB &db, const CancelToken *token);
+		~CancelScope();
+	protected:
+		CouchDB &db;
+		const CancelToken *prevToken;
+	};
+
+	///Sets the cancel token used by all following requests
+	/**
+	 * @param token pointer to the token, or null to remove the token
+	 * @return previous token
+	 *
+	 * @note It is recommended to use CancelScope instead
+	 */
+	const CancelToken *setCancelToken(const CancelToken *token);
+	///Retrieves current cancel token
+	const CancelToken *getCancelToken() const {return cancelToken;}
+
+	///Connects the profile with the connection for the lifetime of the object
+	/**
+	 * Requests performed by the connection inside of the scope record their timing into the
+	 * profile (see QueryProfile). The previous profile is restored when the scope ends.
+	 */
+	class ProfileScope {
+	public:
+		ProfileScope(CouchDB &db, QueryProfile *profile):db(db),prevProfile(db.setProfile(profile)) {}
+		~ProfileScope() {db.setProfile(prevProfile);}
+	protected:
+		CouchDB &db;
+		QueryProfile *prevProfile;
+	};
+
+	///Sets the profile which records timing of all following requests
+	/**
+	 * @param profile pointer to the profile, or null to stop profiling
+	 * @return previous profile
+	 */
+	QueryProfile *setProfile(QueryProfile *profile) {
+		QueryProfile *prev = this->profile;
+		this->profile = profile;
+		return prev;
+	}
+	///Retrieves current profile
+	QueryProfile *getProfile() const {return profile;}
 
 	///Uploads attachment with specified document
 	/**
@@ -555,6 +718,58 @@ public:
 	 */
 	bool uploadDesignDocument(const char *content, natural contentLen, DesignDocUpdateRule updateRule = ddurOverwrite, ConstStrA name = ConstStrA());
 
+	///Progress of the staged deployment (see deployDesignDocument())
+	struct DeployProgress {
+		enum Phase {
+			///staging design document is being uploaded
+			phaseUpload,
+			///index of the staging design document is being built
+			phaseIndexing,
+			///content is being stored to the live design document
+			phaseSwap,
+			///staging design document is being deleted
+			phaseCleanup,
+			///deployment is finished
+			phaseDone
+		};
+		///current phase
+		Phase phase;
+		///progress of the indexing in percents (0-100)
+		natural progress;
+		///name of the staging design document
+		StringA stagingName;
+	};
+
+	///Function which receives the progress of the deployment
+	typedef std::function<void(const DeployProgress &)> DeployProgressFn;
+
+	///Deploys design document without blocking the queries while the index is rebuilt
+	/**
+	 * In contrast to uploadDesignDocument(), which replaces the live design document and
+	 * forces all queries to wait for the new index, the function uploads the content
+	 * to the staging design document (name-staging) at first. Then it starts building
+	 * of the index and polls _active_tasks until the indexer finishes. Once the index is
+	 * ready, the content is stored to the live design document. Because the content is the same,
+	 * CouchDB reuses already built index. Finally the staging design document is deleted.
+	 *
+	 * @note the connection needs administration permissions to do that!
+	 *
+	 * @param content content of design document as pure JSON. The keys _id and _rev are not
+	 * copied to the staging nor the live design document
+	 * @param name name of the design document, with or without "_design/" prefix. If parameter
+	 * is empty, function picks name from the document (under _id key)
+	 * @param progressFn optional function which receives the progress
+	 * @param pollInterval interval in milliseconds between two checks of the indexer
+	 * @retval true design document has been deployed
+	 * @retval false design document is already deployed, nothing changed
+	 *
+	 * @note The function can take long time, the duration can be limited by the CancelToken (see CancelScope).
+	 * The live design document is not changed until the index is built. If the function fails
+	 * or it is canceled, the staging design document is deleted.
+	 */
+	bool deployDesignDocument(ConstValue content, ConstStrA name = ConstStrA(),
+			const DeployProgressFn &progressFn = DeployProgressFn(), natural pollInterval = 1000);
+
 	///Use json variable to build objects
 	const Json json;
 
@@ -580,8 +795,12 @@ protected:
 	JSON::PFactory factory;
 	natural lastStatus;
 	Pointer<QueryCache> cache;
+	Pointer<DocumentCache> docCache;
 	Pointer<Validator> validator;
 	atomicValue *seqNumSlot;
+	atomic *seqInvalidSlot;
+	const CancelToken *cancelToken;
+	QueryProfile *profile;
 	AutoArray<char> uidBuffer;
 	IIDGen& uidGen;
 
@@ -596,8 +815,17 @@ protected:
 	void reqPathToFullPath(ConstStrA reqPath, C &output);
 
 
+	JSON::ConstValue cachedGET(ConstStrA path, const View::CachePolicy *policy, JSON::Value headers, natural flags);
+
 	JSON::ConstValue jsonPUTPOST(HttpClient::Method method, ConstStrA path, JSON::ConstValue postData, JSON::Container headers, natural flags);
 
+	///Parses the response. If the reading has been canceled, rethrows the CanceledException
+	JSON::Value parseResponse(SeqFileInput &in);
+	///Reads whole response and parses it, records the transfer and the parsing to the profile
+	JSON::Value parseProfiled(SeqFileInput &in);
+
+	class CancelGuard;
+
 
 	friend class ChangesSink;
 
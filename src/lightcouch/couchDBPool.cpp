@@ -7,6 +7,11 @@
 
 #include "couchDBPool.h"
 
+#include <memory>
+#include "lightspeed/base/exceptions/errorMessageException.h"
+#include "lightspeed/mt/atomic.h"
+#include "lightspeed/mt/thread.h"
+
 namespace LightCouch {
 
 CouchDBPool::CouchDBPool(
@@ -27,4 +32,43 @@ const char* CouchDBPool::getResourceName() const {
 	return "CouchDB instance";
 }
 
+void CouchDBPool::parallel(natural count, natural maxParallel, const TaskFn &fn) {
+	if (count == 0) return;
+	if (maxParallel == 0 || maxParallel > count) maxParallel = count;
+
+	atomic nextTask = 0;
+	FastLock errLock;
+	PException error;
+
+	auto worker = [&]() {
+		try {
+			MCouchDB db(*this);
+			for(;;) {
+				natural idx = lockInc(nextTask) - 1;
+				if (idx >= count) break;
+				fn(*db, idx);
+			}
+		} catch (const Exception &e) {
+			Synchronized<FastLock> _(errLock);
+			if (error == null) error = e.clone();
+			//stop other workers
+			nextTask = count;
+		} catch (...) {
+			Synchronized<FastLock> _(errLock);
+			if (error == null) error = ErrorMessageException(THISLOCATION,"Unknown exception in the parallel task").clone();
+			nextTask = count;
+		}
+	};
+
+	std::unique_ptr<Thread[]> threads(new Thread[maxParallel-1]);
+	for (natural i = 1; i < maxParallel; i++) {
+		threads[i-1].start(ThreadFunction::create(worker));
+	}
+	worker();
+	for (natural i = 1; i < maxParallel; i++) {
+		threads[i-1].join();
+	}
+	if (error != null) error->throwAgain(THISLOCATION);
+}
+
 } /* namespace LightCouch */
@@ -7,6 +7,7 @@
 
 #ifndef LIBS_LIGHTCOUCH_SRC_LIGHTCOUCH_COUCHDBPOOL_H_
 #define LIBS_LIGHTCOUCH_SRC_LIGHTCOUCH_COUCHDBPOOL_H_
+#include <functional>
 #include <lightspeed/base/containers/resourcePool.h>
 
 #include "couchDB.h"
@@ -61,6 +62,35 @@ public:
 
 	CouchDBPool(const Config &cfg);
 
+	///Task executed by the function parallel()
+	/**
+	 * @param CouchDB& connection acquired from the pool
+	 * @param natural index of the task
+	 */
+	typedef std::function<void(CouchDB &, natural)> TaskFn;
+
+	///Executes tasks in parallel using connections from the pool
+	/**
+	 * Function creates up to maxParallel workers (one of them is the current thread). Every
+	 * worker acquires one connection from the pool and executes tasks one by one until all
+	 * tasks are processed. Function returns after all tasks are finished.
+	 *
+	 * @param count count of tasks. Tasks are numbered from 0 to count-1
+	 * @param maxParallel maximum count of tasks processed at the same time. Note that
+	 * count of the connections is also limited by the pool
+	 * @param fn function which executes the task
+	 *
+	 * @exception any If any task throws an exception, remaining tasks are not started
+	 * and the first exception is rethrown once all running tasks finish.
+	 *
+	 * @note the current thread should not hold a connection from the same pool, otherwise
+	 * the function can block when the pool is exhausted.
+	 *
+	 * @note if the task changes database using CouchDB::use(), it should restore the
+	 * original database before it returns. The connection is returned to the pool.
+	 */
+	void parallel(natural count, natural maxParallel, const TaskFn &fn);
+
 protected:
 	virtual CouchDBManaged *createResource();
 	virtual const char *getResourceName() const;
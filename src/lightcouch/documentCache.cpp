@@ -0,0 +1,137 @@
+/*
+ * documentCache.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "documentCache.h"
+
+#include "lightspeed/base/sync/synchronize.h"
+#include "lightspeed/base/containers/map.tcc"
+#include "lightspeed/base/containers/sort.tcc"
+#include "lightspeed/base/containers/autoArray.tcc"
+
+namespace LightCouch {
+
+DocumentCache::DocumentCache():negativeCaching(false),sizeLimit(10000),accessCounter(0) {
+}
+
+void DocumentCache::enableNegativeCaching(bool enable) {
+	negativeCaching = enable;
+}
+
+StringA DocumentCache::makeKey(ConstStrA database, ConstStrA docId) {
+	//colon cannot be part of database name, so it is safe separator
+	return database + ConstStrA(':') + docId;
+}
+
+DocumentCache::CachedDoc DocumentCache::find(ConstStrA database, ConstStrA docId) const {
+	StringA key = makeKey(database, docId);
+	Synchronized<FastLock> _(lock);
+	const CachedDoc *d = docMap.find(StrKey(key));
+	if (d) {
+		const_cast<CachedDoc *>(d)->lastAccess = ++accessCounter;
+		return *d;
+	} else {
+		return CachedDoc();
+	}
+}
+
+void DocumentCache::set(ConstStrA database, const ConstValue &doc) {
+	ConstValue id = doc["_id"];
+	ConstValue rev = doc["_rev"];
+	if (id == null) return;
+	ConstValue deleted = doc["_deleted"];
+	if (rev == null || (deleted != null && deleted->getBool())) {
+		erase(database, id.getStringA());
+		return;
+	}
+	StrKey key(makeKey(database, id.getStringA()));
+	CachedDoc rec(rev.getStringA(), doc);
+	Synchronized<FastLock> _(lock);
+	store(key, rec);
+}
+
+void DocumentCache::setMissing(ConstStrA database, ConstStrA docId, atomicValue seqNum) {
+	StrKey key(makeKey(database, docId));
+	CachedDoc rec;
+	rec.missing = true;
+	rec.seqNum = seqNum;
+	Synchronized<FastLock> _(lock);
+	store(key, rec);
+}
+
+void DocumentCache::store(const StrKey &key, CachedDoc &rec) {
+	//must be called under lock
+	rec.lastAccess = ++accessCounter;
+	docMap.erase(key);
+	docMap.insert(key, rec);
+	if (docMap.length() > sizeLimit) enforceLimit();
+}
+
+void DocumentCache::setLimit(natural maxDocs) {
+	Synchronized<FastLock> _(lock);
+	sizeLimit = maxDocs?maxDocs:1;
+	if (docMap.length() > sizeLimit) enforceLimit();
+}
+
+namespace {
+	struct EvictCandidate {
+		StringKey<StringA> key;
+		natural lastAccess;
+
+		EvictCandidate() {}
+		EvictCandidate(const StringKey<StringA> &key, natural lastAccess):key(key),lastAccess(lastAccess) {}
+	};
+
+	struct EvictCandidateCmp {
+		bool operator()(const EvictCandidate &a, const EvictCandidate &b) const {
+			//the least recently used first
+			return a.lastAccess < b.lastAccess;
+		}
+	};
+}
+
+void DocumentCache::enforceLimit() {
+	//must be called under lock
+	natural target = sizeLimit - sizeLimit / 10;
+	AutoArray<EvictCandidate> candidates;
+	candidates.reserve(docMap.length());
+	HeapSort<AutoArray<EvictCandidate>, EvictCandidateCmp> heapSort(candidates, EvictCandidateCmp());
+	for (DocMap::Iterator iter = docMap.getFwIter(); iter.hasItems();) {
+		const DocMap::KeyValue &kv = iter.getNext();
+		candidates.add(EvictCandidate(kv.key, kv.value.lastAccess));
+		heapSort.push();
+	}
+	heapSort.sortHeap();
+
+	for (natural i = 0; i < candidates.length() && docMap.length() > target; i++) {
+		docMap.erase(candidates[i].key);
+	}
+}
+
+void DocumentCache::erase(ConstStrA database, ConstStrA docId) {
+	StringA key = makeKey(database, docId);
+	Synchronized<FastLock> _(lock);
+	docMap.erase(StrKey(key));
+}
+
+void DocumentCache::update(ConstStrA database, ConstStrA docId, ConstStrA rev) {
+	StringA key = makeKey(database, docId);
+	Synchronized<FastLock> _(lock);
+	const CachedDoc *d = docMap.find(StrKey(key));
+	if (d && d->rev != rev) docMap.erase(StrKey(key));
+}
+
+void DocumentCache::clear() {
+	Synchronized<FastLock> _(lock);
+	docMap.clear();
+}
+
+natural DocumentCache::size() const {
+	Synchronized<FastLock> _(lock);
+	return docMap.length();
+}
+
+} /* namespace LightCouch */
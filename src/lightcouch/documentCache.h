@@ -0,0 +1,164 @@
+/*
+ * documentCache.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_DOCUMENTCACHE_H_
+#define LIGHTCOUCH_DOCUMENTCACHE_H_
+
+#include <lightspeed/base/containers/constStr.h>
+#include <lightspeed/base/containers/string.h>
+#include "lightspeed/base/containers/stringKey.h"
+#include "lightspeed/base/containers/map.h"
+#include "lightspeed/mt/atomic.h"
+#include "lightspeed/mt/fastlock.h"
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Document cache stores documents by their ID
+/**
+ * In contrast to QueryCache, which stores responses under their path, the document cache
+ * stores the documents under pair database-documentId. The function CouchDB::retrieveDocument()
+ * uses the cache to return document without contacting the server.
+ *
+ * The cache is kept up to date by following ways
+ *  - Changeset::commit() stores every written document along with its new revision (write-through). So
+ *    the document written by the application can be read back without extra request
+ *  - the changes feed (ChangesSink) removes every document, which revision doesn't match
+ *    to the revision stored in the cache
+ *
+ * To have cache consistent with the database, you need to read the changes feed regularly (through
+ * a connection which uses the same cache). Otherwise changes made by other clients will not visible.
+ *
+ * Cache can be shared between many instances of CouchDB connected to the same server. It is MT safe.
+ *
+ * Count of cached documents is limited (see setLimit()). Once the limit is exceeded, the
+ * least recently used documents and records about missing documents are evicted.
+ *
+ * @note As well as QueryCache, the cache holds documents as parsed JSON. Nobody should
+ * modify the documents returned from the cache.
+ */
+class DocumentCache {
+public:
+
+	///Cached document
+	struct CachedDoc {
+		///revision of the document
+		StringA rev;
+		///the document itself
+		ConstValue doc;
+		///the document is known as missing (negative caching)
+		bool missing;
+		///sequence number of the database, when the document has been reported as missing
+		atomicValue seqNum;
+		///value of the access counter at the last access (used for LRU eviction)
+		natural lastAccess;
+
+		CachedDoc():missing(false),seqNum(0),lastAccess(0) {}
+		CachedDoc(StringA rev, ConstValue doc):rev(rev),doc(doc),missing(false),seqNum(0),lastAccess(0) {}
+
+		bool isDefined() const {return doc != null;}
+	};
+
+	///Search for document
+	/**
+	 * @param database name of the database
+	 * @param docId id of the document
+	 * @return cached document. If document is not in the cache, returned object is not defined
+	 */
+	CachedDoc find(ConstStrA database, ConstStrA docId) const;
+
+	///Stores document to the cache
+	/**
+	 * @param database name of the database
+	 * @param doc document to store. The document must have "_id" and "_rev". Documents
+	 * marked as "_deleted" are removed from the cache
+	 */
+	void set(ConstStrA database, const ConstValue &doc);
+
+	///Marks document as missing
+	/** Function is called when server reports, that document doesn't exist and the negative
+	 * caching is enabled. The next attempt to retrieve the document reports "not found"
+	 * without contacting the server, until the sequence number of the database changes. The
+	 * record is also removed, once the document appears in the changes feed or it is written
+	 * by the Changeset
+	 *
+	 * @param database name of the database
+	 * @param docId id of the document
+	 * @param seqNum sequence number of the database at the time of the request
+	 */
+	void setMissing(ConstStrA database, ConstStrA docId, atomicValue seqNum);
+
+	///Enables caching of missing documents (negative caching)
+	/**
+	 * The rules are the same as for the QueryCache. The record about a missing document
+	 * can be validated by the sequence number only, so the negative caching is in effect
+	 * only for connections, which track sequence numbers (see CouchDB::trackSeqNumbers()).
+	 * Any change in the database invalidates all negative records
+	 *
+	 * @param enable true to enable, false to disable. Default is disabled
+	 */
+	void enableNegativeCaching(bool enable);
+
+	///Determines whether negative caching is enabled
+	bool isNegativeCachingEnabled() const {return negativeCaching;}
+
+	///Removes document from the cache
+	/**
+	 * @param database name of the database
+	 * @param docId id of the document
+	 */
+	void erase(ConstStrA database, ConstStrA docId);
+
+	///Processes information about the change
+	/**
+	 * @param database name of the database
+	 * @param docId id of the document
+	 * @param rev new revision of the document. If revision doesn't match
+	 * to the revision of the cached document, the document is removed.
+	 */
+	void update(ConstStrA database, ConstStrA docId, ConstStrA rev);
+
+	///Clears the cache
+	void clear();
+
+	///Retrieves count of documents in the cache
+	natural size() const;
+
+	///Sets the maximum count of documents held by the cache
+	/**
+	 * Once the count of documents exceeds the limit, the cache evicts the least recently used
+	 * documents until the count drops to 90% of the limit. The records about missing
+	 * documents are counted and evicted as well.
+	 *
+	 * @param maxDocs maximum count of documents. Default value is 10000. Specify naturalNull to remove the limit
+	 */
+	void setLimit(natural maxDocs);
+
+	DocumentCache();
+
+protected:
+	typedef StringKey<StringA> StrKey;
+	typedef Map<StrKey, CachedDoc> DocMap;
+
+	DocMap docMap;
+	mutable FastLock lock;
+	bool negativeCaching;
+	natural sizeLimit;
+	mutable natural accessCounter;
+
+	static StringA makeKey(ConstStrA database, ConstStrA docId);
+	void store(const StrKey &key, CachedDoc &rec);
+	void enforceLimit();
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_DOCUMENTCACHE_H_ */
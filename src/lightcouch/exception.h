@@ -87,6 +87,21 @@ public:
 	static const char *msgText;
 
 
+protected:
+
+	void message(ExceptionMsg &msg) const;
+};
+
+///Thrown when the deadline of the CancelToken expires
+class DeadlineExceededException: public CanceledException {
+public:
+
+	LIGHTSPEED_EXCEPTIONFINAL;
+	DeadlineExceededException(const ProgramLocation &loc):CanceledException(loc) {}
+
+	static const char *msgText;
+
+
 protected:
 
 	void message(ExceptionMsg &msg) const;
@@ -0,0 +1,159 @@
+/*
+ * findQuery.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "findQuery.h"
+
+#include "couchDB.h"
+
+namespace LightCouch {
+
+FindResult::FindResult(ConstValue response)
+	:ConstValue(response["docs"]),response(response),rdpos(0)
+{
+}
+
+const ConstValue& FindResult::getNext() {
+	out = (*this)[rdpos++];
+	return out;
+}
+
+const ConstValue& FindResult::peek() const {
+	out = (*this)[rdpos];
+	return out;
+}
+
+bool FindResult::hasItems() const {
+	return rdpos < (*this)->length();
+}
+
+void FindResult::rewind() {
+	rdpos = 0;
+}
+
+ConstStrA FindResult::getBookmark() const {
+	const JSON::INode *bm = response->getPtr("bookmark");
+	if (bm) return bm->getStringUtf8(); else return ConstStrA();
+}
+
+ConstStrA FindResult::getWarning() const {
+	const JSON::INode *w = response->getPtr("warning");
+	if (w) return w->getStringUtf8(); else return ConstStrA();
+}
+
+ConstValue FindResult::getExecutionStats() const {
+	return response->getPtr("execution_stats");
+}
+
+FindQuery::FindQuery(CouchDB& db):db(db) {
+	reset();
+}
+
+FindQuery& FindQuery::selector(ConstValue selector) {
+	sel = selector;
+	return *this;
+}
+
+FindQuery& FindQuery::field(ConstStrA name) {
+	if (fields == null) fields = db.json.array();
+	fields.add(db.json(name));
+	return *this;
+}
+
+FindQuery& FindQuery::sort(ConstStrA name, bool descending) {
+	if (sortFields == null) sortFields = db.json.array();
+	sortFields.add(db.json(name,descending?"desc":"asc"));
+	return *this;
+}
+
+FindQuery& FindQuery::limit(natural limit) {
+	maxlimit = limit;
+	return *this;
+}
+
+FindQuery& FindQuery::skip(natural skip) {
+	skipCount = skip;
+	return *this;
+}
+
+FindQuery& FindQuery::bookmark(ConstStrA bookmark) {
+	bookmarkStr = bookmark;
+	return *this;
+}
+
+FindQuery& FindQuery::useIndex(ConstStrA ddoc, ConstStrA name) {
+	if (name.empty()) index = db.json(ddoc);
+	else {
+		Container idx = db.json.array();
+		idx.add(db.json(ddoc));
+		idx.add(db.json(name));
+		index = idx;
+	}
+	return *this;
+}
+
+FindQuery& FindQuery::executionStats() {
+	stats = true;
+	return *this;
+}
+
+FindQuery& FindQuery::reset() {
+	sel = null;
+	fields = null;
+	sortFields = null;
+	maxlimit = naturalNull;
+	skipCount = 0;
+	bookmarkStr = StringA();
+	index = null;
+	stats = false;
+	return *this;
+}
+
+ConstValue FindQuery::getRequest() const {
+	Container req = db.json.object();
+	//empty selector matches all documents
+	req.set("selector", sel == null?ConstValue(db.json.object()):sel);
+	if (fields != null) req.set("fields", fields);
+	if (sortFields != null) req.set("sort", sortFields);
+	if (maxlimit != naturalNull) req.set("limit", db.json(maxlimit));
+	if (skipCount) req.set("skip", db.json(skipCount));
+	if (!bookmarkStr.empty()) req.set("bookmark", db.json(bookmarkStr));
+	if (index != null) req.set("use_index", index);
+	if (stats) req.set("execution_stats", db.json(true));
+	return req;
+}
+
+FindResult FindQuery::exec() const {
+	return FindResult(db.requestPOST("_find", getRequest()));
+}
+
+ConstValue FindQuery::explain() const {
+	return db.requestPOST("_explain", getRequest());
+}
+
+bool FindQuery::createIndex(ConstValue fields, ConstStrA name, ConstStrA ddoc, ConstValue partialFilter) {
+	Container idx = db.json("fields",fields);
+	if (partialFilter != null) idx.set("partial_filter_selector", partialFilter);
+	Container req = db.json("index",idx)("type","json");
+	if (!name.empty()) req.set("name", db.json(name));
+	if (!ddoc.empty()) req.set("ddoc", db.json(ddoc));
+	ConstValue resp = db.requestPOST("_index", req);
+	return resp["result"]->getStringUtf8() == ConstStrA("created");
+}
+
+ConstValue FindQuery::listIndexes() {
+	return db.requestGET("_index",null,CouchDB::flgDisableCache)["indexes"];
+}
+
+void FindQuery::deleteIndex(ConstStrA ddoc, ConstStrA name) {
+	ConstStrA prefix("_design/");
+	if (ddoc.head(prefix.length()) == prefix) ddoc = ddoc.offset(prefix.length());
+	StringA path = ConstStrA("_index/_design/") + CouchDB::urlencode(ddoc)
+			+ ConstStrA("/json/") + CouchDB::urlencode(name);
+	db.requestDELETE(path);
+}
+
+} /* namespace LightCouch */
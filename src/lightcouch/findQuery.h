@@ -0,0 +1,159 @@
+/*
+ * findQuery.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_FINDQUERY_H_
+#define LIGHTCOUCH_FINDQUERY_H_
+
+#include "lightspeed/base/containers/constStr.h"
+#include "lightspeed/base/containers/string.h"
+#include "lightspeed/base/iter/iterator.h"
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDB;
+
+///Result of the FindQuery
+/**
+ * Object is iterator through the found documents. It also carries the bookmark which
+ * can be used to retrieve the next page.
+ */
+class FindResult: public ConstValue, public IteratorBase<ConstValue, FindResult> {
+public:
+	FindResult(ConstValue response);
+
+	const ConstValue &getNext();
+	const ConstValue &peek() const;
+	bool hasItems() const;
+	void rewind();
+
+	///Retrieves bookmark of the next page
+	/** Pass the bookmark to the FindQuery::bookmark() to continue by the next page */
+	ConstStrA getBookmark() const;
+	///Retrieves warning reported by the server (for example, when no index is used). Can be empty
+	ConstStrA getWarning() const;
+	///Retrieves execution statistics, if requested by FindQuery::executionStats(). Otherwise returns null
+	ConstValue getExecutionStats() const;
+
+protected:
+	ConstValue response;
+	natural rdpos;
+	mutable ConstValue out;
+};
+
+///Builds and executes the query for the endpoint _find (Mango query)
+/**
+ * Filtering and projection are performed by the server, so only matching documents
+ * and requested fields are transferred.
+ *
+ * @code
+ * FindQuery fq(db);
+ * FindResult res = fq.selector(db.json("age",db.json("$gt",40)))
+ *                   .field("name").field("age")
+ *                   .sort("age")
+ *                   .limit(10)
+ *                   .exec();
+ * @endcode
+ *
+ * Object also allows to manage indexes used by the queries.
+ */
+class FindQuery {
+public:
+
+	FindQuery(CouchDB &db);
+
+	///Sets selector
+	/**
+	 * @param selector JSON object in the Mango query syntax
+	 * @return reference to this object to create chain
+	 */
+	FindQuery &selector(ConstValue selector);
+	///Adds field to the list of returned fields
+	/** If no field is added, whole documents are returned */
+	FindQuery &field(ConstStrA name);
+	///Adds sort field
+	/**
+	 * @param name name of the field
+	 * @param descending set true to sort in the descending order
+	 * @return reference to this object to create chain
+	 *
+	 * @note sort fields must be covered by an index
+	 */
+	FindQuery &sort(ConstStrA name, bool descending = false);
+	///Sets maximum count of the results
+	FindQuery &limit(natural limit);
+	///Sets count of the results to skip
+	FindQuery &skip(natural skip);
+	///Sets bookmark to continue from the previous page
+	FindQuery &bookmark(ConstStrA bookmark);
+	///Requests to use the specified index
+	/**
+	 * @param ddoc name of the design document which contains the index
+	 * @param name name of the index. Can be empty
+	 * @return reference to this object to create chain
+	 */
+	FindQuery &useIndex(ConstStrA ddoc, ConstStrA name = ConstStrA());
+	///Requests the execution statistics. See FindResult::getExecutionStats()
+	FindQuery &executionStats();
+	///Resets the query
+	FindQuery &reset();
+
+	///Returns request object sent to the server
+	ConstValue getRequest() const;
+
+	///Executes the query
+	FindResult exec() const;
+
+	///Retrieves which index is used by the query and how the query is executed
+	/**
+	 * @return response of the endpoint _explain
+	 */
+	ConstValue explain() const;
+
+	///Creates the index
+	/**
+	 * @param fields array of the fields. Item can be name of the field, or object {"field":"asc|desc"}
+	 * @param name name of the index. If empty, name is generated by the server
+	 * @param ddoc design document where index will be stored. If empty, new design document is created
+	 * @param partialFilter optional selector which limits the documents in the index
+	 * @return true if index has been created, false if the same index already exists
+	 */
+	bool createIndex(ConstValue fields, ConstStrA name = ConstStrA(), ConstStrA ddoc = ConstStrA(),
+			ConstValue partialFilter = ConstValue());
+
+	///Lists all indexes of the database
+	/**
+	 * @return array of index definitions (fields "ddoc", "name", "type", "def")
+	 */
+	ConstValue listIndexes();
+
+	///Deletes the index
+	/**
+	 * @param ddoc design document of the index (with or without the prefix _design/)
+	 * @param name name of the index
+	 */
+	void deleteIndex(ConstStrA ddoc, ConstStrA name);
+
+protected:
+	CouchDB &db;
+	ConstValue sel;
+	Container fields;
+	Container sortFields;
+	natural maxlimit;
+	natural skipCount;
+	StringA bookmarkStr;
+	ConstValue index;
+	bool stats;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_FINDQUERY_H_ */
@@ -0,0 +1,62 @@
+/*
+ * groupAggregator.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "groupAggregator.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+
+#include "sortKey.h"
+
+namespace LightCouch {
+
+GroupAggregator::GroupAggregator(natural level, const Result::ReduceFunction& reduceFn, const OutputFn& outputFn)
+	:level(level),reduceFn(reduceFn),outputFn(outputFn)
+{
+}
+
+std::string GroupAggregator::groupKey(const ConstValue& key, natural level) {
+	std::string out;
+	//level 0 forms single group
+	if (key == null || level == 0) return out;
+	if (key->getType() != JSON::ndArray || level == naturalNull) {
+		appendSortKey(out, key);
+	} else {
+		//concatenated sort keys of the components compare as the array
+		natural cnt = key->length();
+		if (cnt > level) cnt = level;
+		for (natural i = 0; i < cnt; i++) appendSortKey(out, key[i]);
+	}
+	return out;
+}
+
+void GroupAggregator::add(const ConstValue& row) {
+	std::string k = groupKey(row["key"], level);
+	if (!rows.empty() && k != curKey) {
+		ConstValue res = reduceFn(ConstStringT<ConstValue>(rows));
+		if (res != null) outputFn(res);
+		rows.clear();
+	}
+	if (rows.empty()) curKey.swap(k);
+	rows.add(row);
+}
+
+void GroupAggregator::finish() {
+	if (rows.empty()) return;
+	ConstValue res = reduceFn(ConstStringT<ConstValue>(rows));
+	rows.clear();
+	curKey.clear();
+	if (res != null) outputFn(res);
+}
+
+void GroupAggregator::exec(const Query& q) {
+	q.streamRows([&](const ConstValue &row) {
+		add(row);
+	});
+	finish();
+}
+
+} /* namespace LightCouch */
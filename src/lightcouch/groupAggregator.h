@@ -0,0 +1,82 @@
+/*
+ * groupAggregator.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_GROUPAGGREGATOR_H_
+#define LIGHTCOUCH_GROUPAGGREGATOR_H_
+
+#include <functional>
+#include <string>
+#include "lightspeed/base/containers/autoArray.h"
+
+#include "query.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Groups rows which arrive ordered by the key
+/**
+ * Rows of the view are already ordered by the key, so the groups can be detected on the fly,
+ * without sorting. Aggregator keeps only rows of the current group. Once the row with
+ * a different key prefix arrives, the group is reduced and the result is passed to the output function.
+ *
+ * Aggregator can be fed by rows of a Result, or directly by rows of the response parsed by
+ * the streaming parser (see exec()), so the whole result is never held in the memory.
+ *
+ * @code
+ * GroupAggregator agg(1, reduceFn, [&](const ConstValue &row) {...});
+ * agg.exec(q);
+ * @endcode
+ */
+class GroupAggregator {
+public:
+
+	///Function which receives reduced rows
+	typedef std::function<void(const ConstValue &)> OutputFn;
+
+	///Construct aggregator
+	/**
+	 * @param level count of the components of the key which form the group. If the key is
+	 * not an array, whole key is used. Use naturalNull to group by whole key. Level 0 puts all
+	 * rows into single group
+	 * @param reduceFn function which reduces rows of the group. It can return null to skip the group
+	 * @param outputFn function which receives reduced rows
+	 */
+	GroupAggregator(natural level, const Result::ReduceFunction &reduceFn, const OutputFn &outputFn);
+
+	///Adds row. Rows must be ordered by the key
+	void add(const ConstValue &row);
+	///Reduces the last group. Must be called after the last row is added
+	void finish();
+
+	///Executes the query and aggregates its rows while the response is parsed
+	/**
+	 * @param q query
+	 *
+	 * Function calls finish() at the end
+	 */
+	void exec(const Query &q);
+
+	///Calculates the key of the group as the binary sort key
+	/**
+	 * @param key key of the row
+	 * @param level group level
+	 * @return binary key of the prefix. Prefixes are equal when their binary keys are equal
+	 */
+	static std::string groupKey(const ConstValue &key, natural level);
+
+protected:
+	natural level;
+	Result::ReduceFunction reduceFn;
+	OutputFn outputFn;
+	AutoArray<ConstValue> rows;
+	std::string curKey;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_GROUPAGGREGATOR_H_ */
@@ -0,0 +1,374 @@
+/*
+ * jsonPull.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_JSONPULL_H_
+#define LIGHTCOUCH_JSONPULL_H_
+
+#include <cctype>
+#include <cstdlib>
+#include <string>
+#include <lightspeed/base/containers/autoArray.h>
+#include <lightspeed/base/containers/constStr.h>
+#include <lightspeed/base/exceptions/errorMessageException.h>
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Streaming (pull) JSON parser
+/**
+ * The parser reads JSON token by token directly from the stream without building the
+ * JSON tree. Caller decides what to do with every token - it can read the value, skip
+ * whole subtree or build the JSON tree for the subtree only.
+ *
+ * Separators (commas and colons) are processed by the parser, their placement is checked
+ * against the structure of the document. Strings at the position of a key in an object are
+ * reported as keys (see isKey()). Any syntax error causes ErrorMessageException. The parser
+ * accepts a sequence of top-level values, the tkEof is returned after the last one
+ *
+ * @tparam Iter source iterator of characters (for example SeqFileInput). It must
+ * support functions hasItems(), peek() and getNext()
+ */
+template<typename Iter>
+class JsonPullParser {
+public:
+
+	enum Token {
+		tkNull,
+		tkFalse,
+		tkTrue,
+		tkNumber,
+		tkString,
+		tkBeginObject,
+		tkEndObject,
+		tkBeginArray,
+		tkEndArray,
+		tkEof
+	};
+
+	JsonPullParser(Iter &iter):iter(iter),key(false),isInt(false),state(stTop) {}
+
+	///Reads next token
+	Token next() {
+		key = false;
+		char c;
+		if (!readNonWhite(c)) {
+			if (!nesting.empty() || state == stColon)
+				throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+			return tkEof;
+		}
+
+		switch (state) {
+		case stSeparator:
+			//after a value inside of a container
+			if (c == ',') {
+				state = nesting[nesting.length()-1] == '{'?stKey:stValue;
+				if (!readNonWhite(c)) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+			} else if (c != '}' && c != ']') {
+				throw ErrorMessageException(THISLOCATION,"Expected ',' in JSON");
+			}
+			break;
+		case stColon:
+			if (c != ':') throw ErrorMessageException(THISLOCATION,"Expected ':' in JSON");
+			state = stValue;
+			if (!readNonWhite(c)) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+			break;
+		default:
+			break;
+		}
+
+		if (c == '}' || c == ']') {
+			//closing bracket is allowed after a value or in the empty container
+			if (nesting.empty() || nesting[nesting.length()-1] != (c == '}'?'{':'[')
+					|| (state != stSeparator && state != stFirst))
+				throw ErrorMessageException(THISLOCATION,"Unexpected character in JSON");
+			nesting.resize(nesting.length()-1);
+			afterValue();
+			return c == '}'?tkEndObject:tkEndArray;
+		}
+
+		bool inObject = !nesting.empty() && nesting[nesting.length()-1] == '{';
+		if (state == stKey || (state == stFirst && inObject)) {
+			if (c != '"') throw ErrorMessageException(THISLOCATION,"Expected key in JSON object");
+			readString();
+			key = true;
+			state = stColon;
+			return tkString;
+		}
+
+		switch (c) {
+		case '{':
+		case '[': nesting.add(c);
+				  state = stFirst;
+				  return c == '{'?tkBeginObject:tkBeginArray;
+		case '"': readString();afterValue();return tkString;
+		case 't': expect("rue");afterValue();return tkTrue;
+		case 'f': expect("alse");afterValue();return tkFalse;
+		case 'n': expect("ull");afterValue();return tkNull;
+		default:
+			if (c == '-' || isdigit((unsigned char)c)) {
+				readNumber(c);
+				afterValue();
+				return tkNumber;
+			}
+			throw ErrorMessageException(THISLOCATION,"Unexpected character in JSON");
+		}
+	}
+
+	///Retrieves text of the last string or number token
+	ConstStrA getString() const {return ConstStrA(buffer);}
+	///Determines whether last string token is a key of an object
+	bool isKey() const {return key;}
+	///Retrieves value of last number token
+	double getNumber() const {
+		std::string tmp(buffer.data(), buffer.length());
+		return strtod(tmp.c_str(), 0);
+	}
+	///Retrieves value of last number token as integer
+	integer getInt() const {
+		if (!isInt) return integer(getNumber());
+		std::string tmp(buffer.data(), buffer.length());
+		return integer(strtoll(tmp.c_str(), 0, 10));
+	}
+	///Determines whether last number token is integer (has no fraction and exponent)
+	bool isInteger() const {return isInt;}
+
+	///Skips value which starts by the token
+	/**
+	 * @param t first token of the value. If it is beginning of the object or
+	 * the array, function skips whole subtree.
+	 */
+	void skipValue(Token t) {
+		if (t != tkBeginObject && t != tkBeginArray) return;
+		natural level = 1;
+		while (level) {
+			//strings are read through next(), so brackets in strings are not counted
+			switch (next()) {
+			case tkBeginObject:
+			case tkBeginArray: level++;break;
+			case tkEndObject:
+			case tkEndArray: level--;break;
+			case tkEof: throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+			default: break;
+			}
+		}
+	}
+
+	///Builds JSON tree of the value which starts by the token
+	/**
+	 * @param t first token of the value
+	 * @param json json builder
+	 * @return parsed value
+	 */
+	ConstValue parseValue(Token t, const Json &json) {
+		switch (t) {
+		case tkNull: return json(null);
+		case tkFalse: return json(false);
+		case tkTrue: return json(true);
+		case tkNumber: return isInt?json(getInt()):json(getNumber());
+		case tkString: return json(StringA(getString()));
+		case tkBeginArray: {
+			Container arr = json.array();
+			for (Token x = next(); x != tkEndArray; x = next()) {
+				if (x == tkEof) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+				arr.add(parseValue(x, json));
+			}
+			return arr;
+		}
+		case tkBeginObject: {
+			Container obj = json.object();
+			for (Token x = next(); x != tkEndObject; x = next()) {
+				if (x != tkString) throw ErrorMessageException(THISLOCATION,"Expected key in JSON object");
+				StringA name = getString();
+				obj.set(name, parseValue(next(), json));
+			}
+			return obj;
+		}
+		default:
+			throw ErrorMessageException(THISLOCATION,"Unexpected token in JSON");
+		}
+	}
+
+protected:
+
+	enum State {
+		///top-level value is expected
+		stTop,
+		///first item of the container or its end is expected
+		stFirst,
+		///value is expected (after a colon or after a comma in the array)
+		stValue,
+		///key is expected (after a comma in the object)
+		stKey,
+		///colon is expected after the key
+		stColon,
+		///comma or end of the container is expected
+		stSeparator
+	};
+
+	Iter &iter;
+	AutoArray<char> buffer;
+	///stack of opened containers ('{' or '[')
+	AutoArray<char> nesting;
+	bool key;
+	bool isInt;
+	State state;
+
+	bool readNonWhite(char &c) {
+		do {
+			if (!iter.hasItems()) return false;
+			c = (char)iter.getNext();
+		} while (isspace((unsigned char)c));
+		return true;
+	}
+
+	void afterValue() {
+		state = nesting.empty()?stTop:stSeparator;
+	}
+
+	char readChar() {
+		if (!iter.hasItems()) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+		return (char)iter.getNext();
+	}
+
+	void expect(const char *rest) {
+		while (*rest) {
+			if (readChar() != *rest)
+				throw ErrorMessageException(THISLOCATION,"Unexpected character in JSON");
+			rest++;
+		}
+	}
+
+	void appendUtf8(unsigned int cp) {
+		if (cp < 0x80) {
+			buffer.add(char(cp));
+		} else if (cp < 0x800) {
+			buffer.add(char(0xC0 | (cp >> 6)));
+			buffer.add(char(0x80 | (cp & 0x3F)));
+		} else if (cp < 0x10000) {
+			buffer.add(char(0xE0 | (cp >> 12)));
+			buffer.add(char(0x80 | ((cp >> 6) & 0x3F)));
+			buffer.add(char(0x80 | (cp & 0x3F)));
+		} else {
+			buffer.add(char(0xF0 | (cp >> 18)));
+			buffer.add(char(0x80 | ((cp >> 12) & 0x3F)));
+			buffer.add(char(0x80 | ((cp >> 6) & 0x3F)));
+			buffer.add(char(0x80 | (cp & 0x3F)));
+		}
+	}
+
+	unsigned int readHex4() {
+		unsigned int v = 0;
+		for (int i = 0; i < 4; i++) {
+			char c = readChar();
+			v <<= 4;
+			if (c >= '0' && c <= '9') v |= c - '0';
+			else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+			else throw ErrorMessageException(THISLOCATION,"Invalid escape sequence in JSON");
+		}
+		return v;
+	}
+
+	void readString() {
+		buffer.clear();
+		for(;;) {
+			char c = readChar();
+			if (c == '"') break;
+			if ((unsigned char)c < 0x20)
+				throw ErrorMessageException(THISLOCATION,"Control character in JSON string");
+			if (c != '\\') {
+				buffer.add(c);
+				continue;
+			}
+			c = readChar();
+			switch (c) {
+			case '"':
+			case '\\':
+			case '/': buffer.add(c);break;
+			case 'b': buffer.add('\b');break;
+			case 'f': buffer.add('\f');break;
+			case 'n': buffer.add('\n');break;
+			case 'r': buffer.add('\r');break;
+			case 't': buffer.add('\t');break;
+			case 'u': {
+				unsigned int cp = readHex4();
+				if (cp >= 0xDC00 && cp < 0xE000)
+					throw ErrorMessageException(THISLOCATION,"Invalid surrogate pair in JSON");
+				if (cp >= 0xD800 && cp < 0xDC00) {
+					//surrogate pair
+					expect("\\u");
+					unsigned int lo = readHex4();
+					if (lo < 0xDC00 || lo >= 0xE000)
+						throw ErrorMessageException(THISLOCATION,"Invalid surrogate pair in JSON");
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+				}
+				appendUtf8(cp);
+				break;
+			}
+			default: throw ErrorMessageException(THISLOCATION,"Invalid escape sequence in JSON");
+			}
+		}
+	}
+
+	bool peekChar(char &c) {
+		if (!iter.hasItems()) return false;
+		c = (char)iter.peek();
+		return true;
+	}
+
+	///Reads digits, returns count of digits
+	natural readDigits() {
+		natural cnt = 0;
+		char c;
+		while (peekChar(c) && isdigit((unsigned char)c)) {
+			buffer.add(c);
+			iter.getNext();
+			cnt++;
+		}
+		return cnt;
+	}
+
+	void readNumber(char first) {
+		//-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+		buffer.clear();
+		buffer.add(first);
+		isInt = true;
+		char c = first;
+		if (first == '-') {
+			c = readChar();
+			if (!isdigit((unsigned char)c)) throw ErrorMessageException(THISLOCATION,"Invalid number in JSON");
+			buffer.add(c);
+		}
+		if (c != '0') readDigits();
+		if (peekChar(c) && c == '.') {
+			buffer.add(c);
+			iter.getNext();
+			isInt = false;
+			if (readDigits() == 0) throw ErrorMessageException(THISLOCATION,"Invalid number in JSON");
+		}
+		if (peekChar(c) && (c == 'e' || c == 'E')) {
+			buffer.add(c);
+			iter.getNext();
+			isInt = false;
+			if (peekChar(c) && (c == '+' || c == '-')) {
+				buffer.add(c);
+				iter.getNext();
+			}
+			if (readDigits() == 0) throw ErrorMessageException(THISLOCATION,"Invalid number in JSON");
+		}
+		if (peekChar(c) && (isalnum((unsigned char)c) || c == '.' || c == '-' || c == '+'))
+			throw ErrorMessageException(THISLOCATION,"Invalid number in JSON");
+	}
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_JSONPULL_H_ */
@@ -0,0 +1,94 @@
+/*
+ * multiDatabaseQuery.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "multiDatabaseQuery.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+#include "lightspeed/base/exceptions/invalidParamException.h"
+
+#include "couchDB.h"
+#include "couchDBPool.h"
+#include "sortKey.h"
+
+namespace LightCouch {
+
+MultiDatabaseQuery::MultiDatabaseQuery(CouchDBPool& pool, natural maxParallel)
+	:pool(pool),maxParallel(maxParallel)
+{
+}
+
+MultiDatabaseQuery& MultiDatabaseQuery::add(ConstStrA database) {
+	databases.add(database);
+	return *this;
+}
+
+void MultiDatabaseQuery::clear() {
+	databases.clear();
+}
+
+AutoArray<Result> MultiDatabaseQuery::execEach(const Query& q) const {
+	natural cnt = databases.length();
+	AutoArray<ConstValue> responses;
+	responses.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) responses.add(ConstValue());
+
+	pool.parallel(cnt, maxParallel, [&](CouchDB &db, natural i) {
+		StringA prevDb = db.getCurrentDB();
+		db.use(databases[i]);
+		try {
+			Query dbq(q, db);
+			Result r = dbq.exec();
+			responses(i) = db.json("rows",static_cast<const ConstValue &>(r))
+					("total_rows",r.getTotal())
+					("offset",r.getOffset());
+		} catch (...) {
+			db.use(prevDb);
+			throw;
+		}
+		db.use(prevDb);
+	});
+
+	AutoArray<Result> out;
+	out.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		out.add(Result(q.json, responses[i]));
+	}
+	return out;
+}
+
+Result MultiDatabaseQuery::exec(const Query& q) const {
+	if (q.isDescending())
+		throw InvalidParamException(THISLOCATION,1,"MultiDatabaseQuery cannot merge results in the reversed order");
+	AutoArray<Result> results = execEach(q);
+	return Result::mergeMany(q.json, ConstStringT<Result>(results), mergeUnion);
+}
+
+Result MultiDatabaseQuery::exec(const Query& q, const Result::ReduceFunction& rereduce) const {
+	Result merged = exec(q);
+	AutoArray<ConstValue> rows, output;
+	rows.reserve(merged->length());
+	while (merged.hasItems()) rows.add(merged.getNext());
+
+	natural cnt = rows.length();
+	natural startPos = 0;
+	std::string startKey;
+	if (cnt) startKey = makeSortKey(rows[0]["key"]);
+	for (natural i = 1; i <= cnt; i++) {
+		std::string curKey;
+		if (i < cnt) curKey = makeSortKey(rows[i]["key"]);
+		if (i == cnt || curKey != startKey) {
+			ConstValue res = rereduce(rows.mid(startPos, i-startPos));
+			if (res != null) output.add(res);
+			startPos = i;
+			startKey.swap(curKey);
+		}
+	}
+	JSON::ConstValue newrows = q.json.factory->newValue(ConstStringT<ConstValue>(output));
+	return Result(q.json, q.json("rows",newrows));
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,96 @@
+/*
+ * multiDatabaseQuery.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_MULTIDATABASEQUERY_H_
+#define LIGHTCOUCH_MULTIDATABASEQUERY_H_
+
+#include "lightspeed/base/containers/autoArray.h"
+#include "lightspeed/base/containers/string.h"
+
+#include "query.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDBPool;
+
+///Executes the same query against many databases
+/**
+ * Useful for the database-per-tenant layout. The query is executed on every database in
+ * parallel using connections from the pool. The results are merged in the collation
+ * order of the keys and optionally re-reduced.
+ *
+ * The merge is not streaming. All results are downloaded and held in the memory before
+ * they are merged, so the query should be limited to a reasonable count of rows per database.
+ * The keys are compared by the binary sort keys (see appendSortKey()), which follow the server's
+ * collation including the ICU order of the strings.
+ *
+ * The connections in the pool can share the QueryCache. Cached results are stored under
+ * the database name, so the results of the databases are never mixed.
+ *
+ * @code
+ * MultiDatabaseQuery mq(pool, 8);
+ * mq.add("tenant_a").add("tenant_b").add("tenant_c");
+ * Query q(db.createQuery(by_age));
+ * q.from(20).to(40);
+ * Result res = mq.exec(q);
+ * @endcode
+ */
+class MultiDatabaseQuery {
+public:
+
+	///Construct the object
+	/**
+	 * @param pool pool of connections. Connections are switched to the databases by CouchDB::use(), and
+	 * restored before they are returned back to the pool
+	 * @param maxParallel maximum count of databases queried at the same time
+	 */
+	MultiDatabaseQuery(CouchDBPool &pool, natural maxParallel = 8);
+
+	///Adds database to the list
+	MultiDatabaseQuery &add(ConstStrA database);
+	///Removes all databases
+	void clear();
+	///Returns count of databases
+	natural length() const {return databases.length();}
+
+	///Executes the query on every database
+	/**
+	 * @param q query. It is only used as definition, connection of the query is not used
+	 * @return results in the same order as the databases have been added
+	 */
+	AutoArray<Result> execEach(const Query &q) const;
+
+	///Executes the query on every database and merges the results
+	/**
+	 * @param q query. It is only used as definition, connection of the query is not used. The
+	 * query must not be in the reversed order (see QueryBase::reverseOrder()), because the results
+	 * are merged in the ascending order.
+	 * @return merged result. Rows with equal keys are ordered by the index of the database
+	 */
+	Result exec(const Query &q) const;
+
+	///Executes the query on every database, merges the results and re-reduces rows with equal keys
+	/**
+	 * @param q query. See exec()
+	 * @param rereduce function which receives rows with equal keys and returns one row. It can return null
+	 * to skip the key. The rows are usually results of reduce on each database, so the function must
+	 * be able to combine reduced values (for example sum of sums, count as sum of counts)
+	 * @return merged and re-reduced result
+	 */
+	Result exec(const Query &q, const Result::ReduceFunction &rereduce) const;
+
+protected:
+	CouchDBPool &pool;
+	natural maxParallel;
+	AutoArray<StringA> databases;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_MULTIDATABASEQUERY_H_ */
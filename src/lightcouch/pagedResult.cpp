@@ -0,0 +1,151 @@
+/*
+ * pagedResult.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "pagedResult.h"
+
+#include "couchDBPool.h"
+
+#include "lightspeed/base/exceptions/errorMessageException.h"
+#include "lightspeed/base/exceptions/invalidParamException.h"
+
+namespace LightCouch {
+
+static natural checkPageSize(natural pageSize) {
+	if (pageSize == 0) throw InvalidParamException(THISLOCATION,2,"Page size must not be zero");
+	return pageSize;
+}
+
+PagedResult::PagedResult(QueryBase& query, natural pageSize)
+	:query(query),pageSize(checkPageSize(pageSize)),prefetchQuery(0),pool(0),rdpos(0)
+	,pending(false),eof(false),pageCount(0)
+{
+	cur = fetchPage();
+	rdpos = cur.start;
+}
+
+PagedResult::PagedResult(Query& query, natural pageSize, CouchDBPool &pool)
+	:query(query),pageSize(checkPageSize(pageSize)),prefetchQuery(&query),pool(&pool),rdpos(0)
+	,pending(false),eof(false),pageCount(0)
+{
+	cur = fetchPage();
+	rdpos = cur.start;
+	startPrefetch();
+}
+
+PagedResult::~PagedResult() {
+	if (pending) worker.join();
+}
+
+void PagedResult::preparePage() {
+	if (pageCount == 0) {
+		query.limit(pageSize);
+	} else {
+		//continue from the last row. Startkey is the endkey in the descending order
+		if (query.isDescending()) query.toKey(lastKey);
+		else query.fromKey(lastKey);
+		if (lastId != null) query.limit(lastId.getStringA(), pageSize+1);
+		else query.limit(pageSize+1);
+	}
+}
+
+PagedResult::Page PagedResult::finishPage(const ConstValue &rows) {
+	Page page;
+	page.rows = rows;
+	//first row is the last row of the previous page - skip it
+	if (pageCount != 0 && !page.rows.empty()) {
+		Row first(page.rows[0]);
+		const JSON::PFactory &f = query.json.factory;
+		StringA firstKeyStr = f->toString(*first.key);
+		if (firstKeyStr == f->toString(*lastKey)
+			&& (lastId == null || (first.id != null && first.id.getStringA() == lastId.getStringA())))
+				page.start = 1;
+	}
+	pageCount++;
+	natural cnt = page.rows.length();
+	if (cnt - page.start < pageSize) {
+		eof = true;
+	} else {
+		Row last(page.rows[cnt-1]);
+		lastKey = last.key;
+		lastId = last.id;
+	}
+	return page;
+}
+
+PagedResult::Page PagedResult::fetchPage() {
+	preparePage();
+	return finishPage(query.exec());
+}
+
+void PagedResult::startPrefetch() const {
+	if (eof || pending || pool == 0) return;
+	PagedResult *me = const_cast<PagedResult *>(this);
+	//the query is updated here, the worker only reads it
+	me->preparePage();
+	StringA dbName = prefetchQuery->getDatabase().getCurrentDB();
+	pending = true;
+	nextError = null;
+	worker.start(ThreadFunction::create([me,dbName]{
+		try {
+			//execute a copy of the query through own connection
+			MCouchDB db(*me->pool);
+			db->use(dbName);
+			Query q(*me->prefetchQuery, *db);
+			me->nextRows = q.exec();
+		} catch (const Exception &e) {
+			me->nextError = e.clone();
+		} catch (...) {
+			me->nextError = ErrorMessageException(THISLOCATION,"Unknown exception while prefetching the page").clone();
+		}
+	}));
+}
+
+bool PagedResult::loadNextPage() const {
+	PagedResult *me = const_cast<PagedResult *>(this);
+	if (pending) {
+		worker.join();
+		pending = false;
+		if (nextError != null) {
+			PException e = nextError;
+			nextError = null;
+			eof = true;
+			e->throwAgain(THISLOCATION);
+		}
+		cur = me->finishPage(nextRows);
+		nextRows = null;
+	} else if (eof) {
+		return false;
+	} else {
+		cur = me->fetchPage();
+	}
+	rdpos = cur.start;
+	startPrefetch();
+	return true;
+}
+
+bool PagedResult::hasItems() const {
+	while (rdpos >= cur.rows.length()) {
+		if (!pending && eof) return false;
+		if (!loadNextPage()) return false;
+	}
+	return true;
+}
+
+const ConstValue& PagedResult::getNext() {
+	//loads next page if needed
+	hasItems();
+	out = cur.rows[rdpos++];
+	return out;
+}
+
+const ConstValue& PagedResult::peek() const {
+	hasItems();
+	out = cur.rows[rdpos];
+	return out;
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,119 @@
+/*
+ * pagedResult.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_PAGEDRESULT_H_
+#define LIGHTCOUCH_PAGEDRESULT_H_
+
+#include "lightspeed/base/containers/string.h"
+#include "lightspeed/base/exceptions/exception.h"
+#include "lightspeed/mt/thread.h"
+
+#include "query.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDBPool;
+
+///Iterates through large result page by page
+/**
+ * The object reads the result of the ranged query in pages. Every next page is requested using
+ * key and document-id of the last row of the previous page (keyset pagination), so the server
+ * never skips rows. Memory usage is constant regardless on size of the result.
+ *
+ * If the pool of connections is passed, the next page is downloaded by a background thread
+ * while the current page is being processed. The background thread never touches the connection
+ * nor the JSON factory of the query, it executes a copy of the query through a connection
+ * acquired from the pool. Configure the pool without a shared factory (Config::factory), so each
+ * pooled connection uses own factory.
+ *
+ * @code
+ * Query q(db.createQuery(by_name));
+ * q.from("A").to("Z");
+ * PagedResult res(q, 1000);
+ * while (res.hasItems()) {
+ *     Row row = res.getNext();
+ *     ...
+ * }
+ * @endcode
+ *
+ * The query must be a ranged query (or a query without keys). Query with multiple keys cannot be paged.
+ * The object overrides the limit of the query. The query object is
+ * modified during the iteration, so it cannot be used for other purposes until the iteration is
+ * finished. You have to call reset() on the query before it is used for other query.
+ *
+ * @note object is not MT safe. It can use own thread to prefetch pages, however, the
+ * iteration itself must be done by single thread.
+ */
+class PagedResult: public IteratorBase<ConstValue, PagedResult> {
+public:
+
+	///Starts the iteration, pages are downloaded on demand
+	/**
+	 * @param query prepared ranged query. Function downloads first page immediately
+	 * @param pageSize count of rows per page. It must not be zero
+	 * @exception InvalidParamException pageSize is zero
+	 */
+	PagedResult(QueryBase &query, natural pageSize);
+	///Starts the iteration, next page is downloaded in the background
+	/**
+	 * @param query prepared ranged query. Function downloads first page immediately
+	 * @param pageSize count of rows per page. It must not be zero
+	 * @param pool pool of connections used to prefetch the next page. The pool must be connected
+	 * to the same server as the connection of the query
+	 * @exception InvalidParamException pageSize is zero
+	 */
+	PagedResult(Query &query, natural pageSize, CouchDBPool &pool);
+	///Stops the iteration. If prefetch is pending, destructor waits for finishing
+	~PagedResult();
+
+	const ConstValue &getNext();
+	const ConstValue &peek() const;
+	bool hasItems() const;
+
+	///Retrieves count of pages downloaded so far
+	natural getPageCount() const {return pageCount;}
+
+protected:
+
+	struct Page {
+		ConstValue rows;
+		natural start;
+
+		Page():start(0) {}
+	};
+
+	QueryBase &query;
+	natural pageSize;
+	Query *prefetchQuery;
+	CouchDBPool *pool;
+
+	mutable Page cur;
+	mutable natural rdpos;
+	mutable ConstValue out;
+
+	mutable ConstValue nextRows;
+	mutable PException nextError;
+	mutable Thread worker;
+	mutable bool pending;
+	mutable bool eof;
+	mutable natural pageCount;
+
+	ConstValue lastKey;
+	ConstValue lastId;
+
+	Page fetchPage();
+	void preparePage();
+	Page finishPage(const ConstValue &rows);
+	void startPrefetch() const;
+	bool loadNextPage() const;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_PAGEDRESULT_H_ */
@@ -0,0 +1,111 @@
+/*
+ * parallelScan.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "parallelScan.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+
+#include "couchDBPool.h"
+#include "sortKey.h"
+
+namespace LightCouch {
+
+ParallelScan::ParallelScan(CouchDBPool& pool, const View& view, natural partitions, natural maxParallel)
+	:json(JSON::create()),pool(pool),view(view),partitions(partitions),maxParallel(maxParallel)
+{
+}
+
+ParallelScan& ParallelScan::range(ConstValue startkey, ConstValue endkey) {
+	this->startkey = startkey;
+	this->endkey = endkey;
+	return *this;
+}
+
+ParallelScan& ParallelScan::setBoundaries(ConstValue keys) {
+	boundaries = keys;
+	return *this;
+}
+
+ConstValue ParallelScan::sampleBoundaries(CouchDB& db) {
+	Container out = json.array();
+	if (partitions < 2) return out;
+
+	Query q(db, view);
+	natural total = q.limit(0).exec().getTotal();
+	for (natural i = 1; i < partitions; i++) {
+		q.reset();
+		Result res = q.limit(total * i / partitions, 1).exec();
+		if (res.hasItems()) {
+			Row row(res.getNext());
+			out.add(row.key);
+		}
+	}
+	return out;
+}
+
+ConstValue ParallelScan::getBoundaries() {
+	ConstValue keys = boundaries;
+	if (keys == null) {
+		MCouchDB db(pool);
+		keys = sampleBoundaries(*db);
+	}
+	//remove duplicates and keys outside of the range. Keys are compared in the order of the view
+	Container out = json.array();
+	std::string prev = startkey != null?makeSortKey(startkey):std::string();
+	std::string end = endkey != null?makeSortKey(endkey):std::string();
+	for (natural i = 0, cnt = keys.length(); i < cnt; i++) {
+		ConstValue k = keys[i];
+		std::string sk = makeSortKey(k);
+		if (!prev.empty() && sk <= prev) continue;
+		if (!end.empty() && sk >= end) break;
+		out.add(k);
+		prev.swap(sk);
+	}
+	return out;
+}
+
+Result ParallelScan::execPartition(CouchDB& db, natural index) const {
+	natural last = boundaries.length();
+	//every partition except the last one excludes its end, which is the start of the next partition
+	View v = index < last?view.setFlags(view.flags | View::exludeEnd):view;
+	Query q(db, v);
+	ConstValue from = index > 0?boundaries[index-1]:startkey;
+	ConstValue to = index < last?boundaries[index]:endkey;
+	if (from != null) q.fromKey(from);
+	if (to != null) q.toKey(to);
+	return q.exec();
+}
+
+void ParallelScan::exec(const PartitionFn &fn) {
+	boundaries = getBoundaries();
+	natural count = boundaries.length() + 1;
+	pool.parallel(count, maxParallel, [&](CouchDB &db, natural index) {
+		fn(execPartition(db, index), index);
+	});
+}
+
+Result ParallelScan::exec() {
+	boundaries = getBoundaries();
+	natural count = boundaries.length() + 1;
+	AutoArray<ConstValue> parts;
+	parts.reserve(count);
+	for (natural i = 0; i < count; i++) parts.add(ConstValue());
+	pool.parallel(count, maxParallel, [&](CouchDB &db, natural index) {
+		parts(index) = execPartition(db, index);
+	});
+
+	Container rows = json.array();
+	for (natural i = 0; i < count; i++) {
+		ConstValue p = parts[i];
+		for (natural j = 0, cnt = p.length(); j < cnt; j++) {
+			rows.add(p[j]);
+		}
+	}
+	return Result(json, json("rows",rows)("total_rows",rows.length())("offset",natural(0)));
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,116 @@
+/*
+ * parallelScan.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_PARALLELSCAN_H_
+#define LIGHTCOUCH_PARALLELSCAN_H_
+
+#include <functional>
+#include "lightspeed/base/containers/autoArray.h"
+
+#include "query.h"
+#include "view.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDBPool;
+
+///Scans whole view (or its range) using multiple connections in parallel
+/**
+ * The view is split into disjoint ranges by boundary keys. Every range is downloaded
+ * through its own connection from the pool. The boundaries can be supplied by
+ * the caller or they can be sampled from the view using few probe requests (limit=1&skip=N).
+ *
+ * Result can be delivered ordered (in collation order, the partitions are concatenated) or
+ * unordered through a callback, which is called as soon as each partition arrives.
+ *
+ * @code
+ * CouchDBPool pool(cfg);
+ * ParallelScan scan(pool, View("_design/users/_view/by_name"), 8);
+ * Result res = scan.exec();
+ * @endcode
+ *
+ * @note The view must not be defined with View::reverseOrder. Views with View::reduce are
+ * scanned with the current group level of the view.
+ */
+class ParallelScan {
+public:
+
+	///Callback which receives the rows of a partition
+	/**
+	 * @param Result rows of the partition
+	 * @param natural index of the partition
+	 *
+	 * @note callback is called from multiple threads at the same time. It must be MT safe
+	 */
+	typedef std::function<void(Result, natural)> PartitionFn;
+
+	///Prepares the scan
+	/**
+	 * @param pool pool of connections. Connections must have selected the database (see Config::databaseName)
+	 * @param view view to scan
+	 * @param partitions count of partitions (ranges). If boundaries are sampled, the count can
+	 * be lower, when the view contains too many duplicated keys
+	 * @param maxParallel maximum count of partitions downloaded at the same time
+	 */
+	ParallelScan(CouchDBPool &pool, const View &view, natural partitions, natural maxParallel = 4);
+
+	///Limits the scan to the range of keys
+	/**
+	 * @param startkey first key (inclusive). Can be null
+	 * @param endkey last key (inclusive). Can be null
+	 * @return reference to this object
+	 */
+	ParallelScan &range(ConstValue startkey, ConstValue endkey);
+
+	///Sets boundaries between the partitions
+	/**
+	 * @param keys array of keys ordered by collation order. Every key starts new partition. Count of
+	 * partitions is one more than count of keys. If not set, the boundaries are sampled
+	 * during the exec()
+	 * @return reference to this object
+	 */
+	ParallelScan &setBoundaries(ConstValue keys);
+
+	///Samples boundaries from the view
+	/**
+	 * @param db connection used for sampling
+	 * @return array of keys which split view into equally sized partitions. Function uses
+	 * total_rows reported by the view, so sampling ignores range defined by the function range()
+	 */
+	ConstValue sampleBoundaries(CouchDB &db);
+
+	///Executes scan and returns the ordered result
+	/**
+	 * @return rows in collation order
+	 */
+	Result exec();
+
+	///Executes scan and delivers partitions unordered
+	/**
+	 * @param fn function called for every partition.
+	 */
+	void exec(const PartitionFn &fn);
+
+	const Json json;
+
+protected:
+	CouchDBPool &pool;
+	View view;
+	natural partitions;
+	natural maxParallel;
+	ConstValue startkey, endkey;
+	ConstValue boundaries;
+
+	Result execPartition(CouchDB &db, natural index) const;
+	ConstValue getBoundaries();
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_PARALLELSCAN_H_ */
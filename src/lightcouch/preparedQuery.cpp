@@ -0,0 +1,82 @@
+/*
+ * preparedQuery.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "preparedQuery.h"
+
+#include <lightspeed/base/containers/autoArray.tcc>
+#include <lightspeed/base/text/textOut.tcc>
+#include <lightspeed/utils/json/jsonserializer.tcc>
+#include <lightspeed/utils/urlencode.h>
+#include "lightspeed/base/exceptions/invalidParamException.h"
+
+#include "couchDB.h"
+
+namespace LightCouch {
+
+PreparedQuery::PreparedQuery(const Query& query, Shape shape)
+	:json(query.json)
+	,db(query.db)
+	,viewDefinition(query.viewDefinition)
+	,shape(shape)
+	,descent(query.descent)
+	,args(query.args)
+{
+	query.finishCurrent();
+	UrlLine line;
+	query.buildUrlPrefix(line, shape == shapeKeys);
+	prefix = line.getArray();
+}
+
+void PreparedQuery::checkShape(Shape s) const {
+	if (s != shape)
+		throw InvalidParamException(THISLOCATION,1,"The query has been prepared for different shape of keys");
+}
+
+void PreparedQuery::appendKey(ConstStrA argName, const ConstValue& key) const {
+	TextOut<UrlLine &, SmallAlloc<256> > fmt(urlline);
+	fmt("&%1=") << argName;
+	FilterWrite<UrlLine &, UrlEncoder> wrt(urlline);
+	JSON::serialize(key,wrt,true);
+}
+
+Result PreparedQuery::finish(ConstValue result) const {
+	if (viewDefinition.postprocess) {
+		result = viewDefinition.postprocess(&db, args, result);
+	}
+	return Result(json,result);
+}
+
+Result PreparedQuery::exec(const ConstValue& key) const {
+	checkShape(shapeKey);
+	urlline.clear();
+	urlline.blockWrite(prefix,true);
+	appendKey("key",key);
+	return finish(db.requestGET(urlline.getArray(), viewDefinition.cachePolicy));
+}
+
+Result PreparedQuery::exec(const ConstValue& startkey, const ConstValue& endkey) const {
+	checkShape(shapeRange);
+	urlline.clear();
+	urlline.blockWrite(prefix,true);
+	if (startkey != null) appendKey(descent?"endkey":"startkey",startkey);
+	if (endkey != null) appendKey(descent?"startkey":"endkey",endkey);
+	return finish(db.requestGET(urlline.getArray(), viewDefinition.cachePolicy));
+}
+
+Result PreparedQuery::execKeys(const ConstValue& keys) const {
+	checkShape(shapeKeys);
+	urlline.clear();
+	urlline.blockWrite(prefix,true);
+	if (viewDefinition.flags & View::forceGETMethod) {
+		appendKey("keys",keys);
+		return finish(db.requestGET(urlline.getArray(), viewDefinition.cachePolicy));
+	} else {
+		return finish(db.requestPOST(urlline.getArray(), json("keys",keys)));
+	}
+}
+
+} /* namespace LightCouch */
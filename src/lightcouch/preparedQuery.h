@@ -0,0 +1,117 @@
+/*
+ * preparedQuery.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_PREPAREDQUERY_H_
+#define LIGHTCOUCH_PREPAREDQUERY_H_
+
+#include "lightspeed/base/containers/string.h"
+#include "lightspeed/base/containers/autoArray.h"
+
+#include "query.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Query compiled once and executed many times with different keys
+/**
+ * The Query object rebuilds whole URL on every exec(). The PreparedQuery builds the path to the view
+ * and all arguments which don't depend on the keys once during construction. Every
+ * execution just appends serialized and url-encoded keys to the prepared prefix. Keys are
+ * serialized directly into reusable buffer without creating temporary strings.
+ *
+ * @code
+ * Query q(db.createQuery(by_name));
+ * q.limit(10);
+ * PreparedQuery pq(q, PreparedQuery::shapeKey);
+ *
+ * Result r1 = pq.exec(db.json("Kermit Byrd"));
+ * Result r2 = pq.exec(db.json("Owen Dillard"));
+ * @endcode
+ *
+ * @note object is not MT safe, because it shares the buffer between executions. Create
+ * one instance for each thread
+ */
+class PreparedQuery {
+public:
+
+	///Defines which keys will be supplied for the execution
+	enum Shape {
+		///single key (argument key)
+		shapeKey,
+		///range of keys (arguments startkey and endkey)
+		shapeRange,
+		///multiple keys (argument keys, or POST if the View::forceGETMethod is not set)
+		shapeKeys
+	};
+
+	///Prepares the query
+	/**
+	 * @param query the query which defines the view and all other arguments, such a limit, group level,
+	 * ordering, stale mode and custom arguments. Keys selected by the query are ignored. The query
+	 * is no longer needed after the PreparedQuery is constructed, however, the database object must be kept
+	 *
+	 * @param shape defines shape of the keys supplied to the function exec()
+	 */
+	PreparedQuery(const Query &query, Shape shape);
+
+	///Executes query with a single key
+	/**
+	 * @param key key to search
+	 * @return result of the query
+	 *
+	 * @exception InvalidParamException the query has not been prepared for a single key
+	 */
+	Result exec(const ConstValue &key) const;
+
+	///Executes query for range of keys
+	/**
+	 * @param startkey first key of the range. Can be null, if range has no beginning
+	 * @param endkey last key of the range. Can be null, if range has no end
+	 * @return result of the query
+	 *
+	 * @note as well as for the Query, keys must not be reversed, when reverse ordering is requested
+	 *
+	 * @exception InvalidParamException the query has not been prepared for a range
+	 */
+	Result exec(const ConstValue &startkey, const ConstValue &endkey) const;
+
+	///Executes query with multiple keys
+	/**
+	 * @param keys array of keys
+	 * @return result of the query
+	 *
+	 * @exception InvalidParamException the query has not been prepared for a multiple keys
+	 */
+	Result execKeys(const ConstValue &keys) const;
+
+	///Retrieves prepared prefix (path and arguments)
+	ConstStrA getPrefix() const {return prefix;}
+
+	const Json json;
+
+protected:
+
+	typedef AutoArrayStream<char> UrlLine;
+
+	CouchDB &db;
+	View viewDefinition;
+	Shape shape;
+	bool descent;
+	JSON::Value args;
+	StringA prefix;
+
+	mutable UrlLine urlline;
+
+	void appendKey(ConstStrA argName, const ConstValue &key) const;
+	Result finish(ConstValue result) const;
+	void checkShape(Shape s) const;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_PREPAREDQUERY_H_ */
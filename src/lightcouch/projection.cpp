@@ -0,0 +1,96 @@
+/*
+ * projection.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "projection.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+
+namespace LightCouch {
+
+Projection::Projection() {
+	nodes.push_back(Node());
+}
+
+Projection& Projection::add(ConstStrA path) {
+	natural cur = 0;
+	for (ConstStrA::SplitIterator iter = path.split('.'); iter.hasItems();) {
+		//whole subtree is already kept
+		if (nodes[cur].whole) return *this;
+		ConstStrA part = iter.getNext();
+		std::string name(part.data(), part.length());
+		natural next = naturalNull;
+		for (natural i = 0; i < nodes[cur].children.size(); i++) {
+			if (nodes[cur].children[i].name == name) {
+				next = nodes[cur].children[i].node;
+				break;
+			}
+		}
+		if (next == naturalNull) {
+			Child c;
+			c.name = name;
+			c.node = next = nodes.size();
+			nodes.push_back(Node());
+			nodes[cur].children.push_back(c);
+		}
+		cur = next;
+	}
+	nodes[cur].whole = true;
+	return *this;
+}
+
+ConstValue Projection::parse(Parser& p, Parser::Token t, const Json& json) const {
+	return parseNode(0, p, t, json);
+}
+
+ConstValue Projection::parse(SeqFileInput& in, const Json& json) const {
+	Parser p(in);
+	return parseNode(0, p, p.next(), json);
+}
+
+ConstValue Projection::parseNode(natural nodeIdx, Parser& p, Parser::Token t, const Json& json) const {
+	const Node &n = nodes[nodeIdx];
+	if (n.whole) return p.parseValue(t, json);
+
+	switch (t) {
+	case Parser::tkBeginObject: {
+		Container obj = json.object();
+		for (Parser::Token k = p.next(); k != Parser::tkEndObject; k = p.next()) {
+			if (k != Parser::tkString) throw ErrorMessageException(THISLOCATION,"Expected key in JSON object");
+			ConstStrA name = p.getString();
+			natural child = naturalNull;
+			for (natural i = 0; i < n.children.size(); i++) {
+				const std::string &cn = n.children[i].name;
+				if (ConstStrA(cn.data(), cn.length()) == name) {
+					child = n.children[i].node;
+					break;
+				}
+			}
+			if (child == naturalNull) {
+				p.skipValue(p.next());
+			} else {
+				//name is stored in the parser's buffer, it must be copied before the value is read
+				StringA key = name;
+				Parser::Token v = p.next();
+				obj.set(key, parseNode(child, p, v, json));
+			}
+		}
+		return obj;
+	}
+	case Parser::tkBeginArray: {
+		Container arr = json.array();
+		for (Parser::Token v = p.next(); v != Parser::tkEndArray; v = p.next()) {
+			if (v == Parser::tkEof) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+			arr.add(parseNode(nodeIdx, p, v, json));
+		}
+		return arr;
+	}
+	default:
+		return p.parseValue(t, json);
+	}
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,92 @@
+/*
+ * projection.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_PROJECTION_H_
+#define LIGHTCOUCH_PROJECTION_H_
+
+#include <string>
+#include <vector>
+#include <lightspeed/base/containers/constStr.h>
+#include <lightspeed/base/streams/fileio.h>
+#include <lightspeed/utils/json/json.h>
+
+#include "jsonPull.h"
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Selects parts of the JSON which are kept while the JSON is parsed
+/**
+ * Projection contains list of dot separated paths, for example "name", "address.city". While
+ * the JSON is parsed, only the values on the paths are built, other parts of the JSON are
+ * skipped by the parser without allocating them.
+ *
+ * Arrays are transparent for the paths. The path is applied to every item of the array. For
+ * example path "rows.doc.name" keeps field "name" of the field "doc" of every row.
+ *
+ * If the path ends by a container (object or array), whole container is kept.
+ */
+class Projection {
+public:
+
+	typedef JsonPullParser<SeqFileInput> Parser;
+
+	Projection();
+
+	///Adds path to the projection
+	/**
+	 * @param path dot separated path.
+	 * @return reference to this object to create chain
+	 */
+	Projection &add(ConstStrA path);
+
+	///Returns true, if projection is empty.
+	/** Empty projection doesn't keep anything */
+	bool empty() const {return nodes[0].children.empty() && !nodes[0].whole;}
+
+	///Parses the value and keeps only selected parts
+	/**
+	 * @param p parser
+	 * @param t first token of the value
+	 * @param json json builder
+	 * @return projected value
+	 */
+	ConstValue parse(Parser &p, Parser::Token t, const Json &json) const;
+
+	///Parses the stream and keeps only selected parts
+	/**
+	 * @param in input stream
+	 * @param json json builder
+	 * @return projected value
+	 */
+	ConstValue parse(SeqFileInput &in, const Json &json) const;
+
+protected:
+
+	struct Child {
+		std::string name;
+		natural node;
+	};
+
+	struct Node {
+		std::vector<Child> children;
+		///keep whole subtree
+		bool whole;
+
+		Node():whole(false) {}
+	};
+
+	std::vector<Node> nodes;
+
+	ConstValue parseNode(natural nodeIdx, Parser &p, Parser::Token t, const Json &json) const;
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_PROJECTION_H_ */
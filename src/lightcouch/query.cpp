@@ -6,12 +6,22 @@
  */
 
 #include <lightspeed/base/text/textOut.tcc>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "query.h"
 #include "lightspeed/base/containers/autoArray.tcc"
 #include "lightspeed/base/containers/map.tcc"
 
 #include "collation.h"
+#include "sortKey.h"
 #include "couchDB.h"
+#include "couchDBPool.h"
+#include "projection.h"
+#include "groupAggregator.h"
+#include "jsonPull.h"
+#include "queryProfile.h"
 #include "query.tcc"
 
 namespace LightCouch {
@@ -36,6 +46,7 @@ QueryBase& QueryBase::reset() {
 	descent = (viewFlags & View::reverseOrder) != 0;
 	forceArray = false;
 	args = null;
+	projection.clear();
 
 	return *this;
 }
@@ -174,21 +185,19 @@ void QueryBase::appendCustomArg(UrlFormatter &fmt, ConstStrA key, const JSON::IN
 	}
 }
 
-Result Query::exec() const {
-
-
-	finishCurrent();
+void Query::buildUrlPrefix(UrlLine &out, bool multiKey) const {
 
 	StringA hlp;
 
-	urlline.clear();
-	urlline.blockWrite(viewDefinition.viewPath,true);
-	TextOut<AutoArrayStream<char> &, SmallAlloc<256> > urlformat(urlline);
+	out.blockWrite(getRequestPath(),true);
+	UrlFormatter urlformat(out);
 	if (groupLevel==naturalNull)  urlformat("?reduce=false");
-	else if (keys == null || keys->length() == 1){
+	else if (!multiKey){
 		urlformat("?group_level=%1") << groupLevel;
 	} else if (groupLevel > 0){
 		urlformat("?group=true") ;
+	} else {
+		urlformat("?group=false") ;
 	}
 
 	if (descent) {
@@ -240,8 +249,37 @@ Result Query::exec() const {
 	case smUpdateAfter: urlformat("&stale=update_after");break;
 	case smStale: urlformat("&stale=ok");break;
 	}
+}
 
-	ConstValue result;
+ConstValue Query::execRequest(CouchDB &db, const Json &json, UrlLine &urlline, const ConstValue &keys, bool multiKey) const {
+	QueryProfile::Stopwatch sw;
+	ConstValue postData = buildRequest(json, urlline, keys, multiKey);
+	QueryProfile *profile = db.getProfile();
+	if (profile) profile->urlBuild += sw.lap();
+	if (!projection.empty()) {
+		Projection proj;
+		proj.add("total_rows").add("offset").add("update_seq").add("rows.id").add("rows.key");
+		for (natural i = 0; i < projection.length(); i++) {
+			proj.add(StringA(ConstStrA("rows.") + ConstStrA(projection[i])));
+		}
+		ConstValue result;
+		db.requestStream(urlline.getArray(), postData, CouchDB::ResponseFn([&](SeqFileInput in) {
+			result = proj.parse(in, json);
+		}));
+		return result;
+	}
+	if (postData == null) return db.requestGET(urlline.getArray(), viewDefinition.cachePolicy);
+	else return db.requestPOST(urlline.getArray(), postData);
+}
+
+ConstValue Query::buildRequest(const Json &json, UrlLine &urlline, const ConstValue &keys, bool multiKey) const {
+
+	StringA hlp;
+
+	if (keys != null && keys->length() > 1) multiKey = true;
+	urlline.clear();
+	buildUrlPrefix(urlline, multiKey);
+	UrlFormatter urlformat(urlline);
 
 	if (keys == nil) {
 
@@ -252,24 +290,160 @@ Result Query::exec() const {
 			urlformat(descent?"&startkey=%1":"&endkey=%1") << (hlp=CouchDB::urlencode(json.factory->toString(*endkey)));
 		}
 
-		result = db.requestGET(urlline.getArray());
-	} else if (keys->length() == 1) {
+		return null;
+	} else if (!multiKey) {
 		urlformat("&key=%1") << (hlp=CouchDB::urlencode(json.factory->toString(*(keys[0]))));
-		result = db.requestGET(urlline.getArray());
+		return null;
 	} else {
 		if (viewDefinition.flags & View::forceGETMethod) {
 			urlformat("&keys=%1") << (hlp=CouchDB::urlencode(json.factory->toString(*keys)));
-			result = db.requestGET(urlline.getArray());
+			return null;
 		} else {
-			JSON::Container req = json("keys",keys);
-			result = db.requestPOST(urlline.getArray(), req);
+			return json("keys",keys);
 		}
 	}
+}
+
+ConstValue Query::execChunked() const {
+	//prepare chunks in advance, json builder is not shared between threads
+	natural cnt = keys.length();
+	natural chunkCount = (cnt + chunkSize - 1) / chunkSize;
+	AutoArray<ConstValue> chunks, results;
+	chunks.reserve(chunkCount);
+	results.reserve(chunkCount);
+	for (natural i = 0; i < chunkCount; i++) {
+		Container chunk = json.array();
+		for (natural j = i * chunkSize, e = (cnt - j < chunkSize)?cnt:j + chunkSize; j < e; j++) {
+			chunk.add(keys[j]);
+		}
+		chunks.add(chunk);
+		results.add(ConstValue());
+	}
+
+	if (chunkPool) {
+		const CancelToken *token = db.getCancelToken();
+		StringA dbName = db.getCurrentDB();
+		chunkPool->parallel(chunkCount, chunkParallel, [&](CouchDB &c, natural index) {
+			CouchDB::CancelScope _(c, token);
+			StringA prevDb = c.getCurrentDB();
+			c.use(dbName);
+			try {
+				UrlLine line;
+				results(index) = execRequest(c, c.json, line, chunks[index], true);
+			} catch (...) {
+				c.use(prevDb);
+				throw;
+			}
+			c.use(prevDb);
+		});
+	} else {
+		for (natural i = 0; i < chunkCount; i++) {
+			results(i) = execRequest(db, json, urlline, chunks[i], true);
+		}
+	}
+
+	//rows are returned in order of the keys, so concatenation keeps the order
+	Container rows = json.array();
+	for (natural i = 0; i < chunkCount; i++) {
+		ConstValue r = results[i]["rows"];
+		for (natural j = 0, rcnt = r.length(); j < rcnt; j++) {
+			rows.add(r[j]);
+		}
+	}
+	Container result = json("rows",rows)("offset",natural(0));
+	ConstValue total = results[0]["total_rows"];
+	if (total != null) result.set("total_rows",total);
+	return result;
+}
+
+Result Query::exec() const {
+
+
+	finishCurrent();
+
+	ConstValue result;
+
+	//reduce without grouping returns one row for all keys, it cannot be assembled from the chunks
+	if (keys != nil && keys.length() > chunkSize && offset == 0 && maxlimit == naturalNull
+			&& groupLevel != 0) {
+		result = execChunked();
+	} else {
+		result = execRequest(db, json, urlline, keys);
+	}
+	QueryProfile *profile = db.getProfile();
+	QueryProfile::Stopwatch sw;
 	if (viewDefinition.postprocess) {
 		result = viewDefinition.postprocess(&db, args,result);
+		if (profile) profile->postprocess += sw.lap();
 	}
-	return Result(json,result);
+	Result res(json,result);
+	if (profile) profile->resultBuild += sw.lap();
+	return res;
+
+}
+
+Query& Query::partition(ConstStrA partitionKey) {
+	this->partitionKey = partitionKey;
+	return *this;
+}
+
+StringA Query::getRequestPath() const {
+	ConstStrA viewPath = viewDefinition.viewPath;
+	//absolute paths are not prefixed
+	if (partitionKey.empty() || viewPath.head(1) == ConstStrA('/')) return viewPath;
+	return ConstStrA("_partition/") + CouchDB::urlencode(partitionKey) + ConstStrA("/") + viewPath;
+}
+
+void Query::streamTokens(const RowTokenFn &rowFn, const FieldTokenFn &fieldFn) const {
+	finishCurrent();
+	ConstValue postData = buildRequest(json, urlline, keys);
+	db.requestStream(urlline.getArray(), postData, CouchDB::ResponseFn([&](SeqFileInput in) {
+		RowParser p(in);
+		if (p.next() != RowParser::tkBeginObject)
+			throw ErrorMessageException(THISLOCATION,"Unexpected format of the response");
+		for (RowParser::Token t = p.next(); t != RowParser::tkEndObject; t = p.next()) {
+			if (t != RowParser::tkString) throw ErrorMessageException(THISLOCATION,"Unexpected format of the response");
+			//the buffer of the parser is reused by the next token
+			StringA name = p.getString();
+			RowParser::Token v = p.next();
+			if (name == ConstStrA("rows") && v == RowParser::tkBeginArray) {
+				//the parser checks the structure, the end of input inside of the array is reported as an error
+				for (RowParser::Token r = p.next(); r != RowParser::tkEndArray; r = p.next()) {
+					rowFn(p, r);
+				}
+			} else if (fieldFn) {
+				fieldFn(p, name, v);
+			} else {
+				p.skipValue(v);
+			}
+		}
+	}));
+}
+
+void Query::streamRows(const RowFn &rowFn) const {
+	streamTokens(RowTokenFn([&](RowParser &p, RowParser::Token r) {
+		rowFn(p.parseValue(r, json));
+	}));
+}
+
+Result Query::exec(const CancelToken &token) const {
+	CouchDB::CancelScope _(db, &token);
+	return exec();
+}
 
+Result Query::execProfiled(QueryProfile &profile) const {
+	QueryProfile::Stopwatch sw;
+	CouchDB::ProfileScope _(db, &profile);
+	Result res = exec();
+	profile.total += sw.lap();
+	return res;
+}
+
+Query& Query::splitKeys(natural chunkSize, CouchDBPool *pool, natural maxParallel) {
+	this->chunkSize = chunkSize?chunkSize:naturalNull;
+	this->chunkPool = pool;
+	this->chunkParallel = maxParallel;
+	return *this;
 }
 
 QueryBase& QueryBase::group(natural level) {
@@ -294,6 +468,11 @@ QueryBase& QueryBase::reverseOrder() {
 	return *this;
 }
 
+QueryBase& QueryBase::project(ConstStrA path) {
+	projection.add(path);
+	return *this;
+}
+
 QueryBase& QueryBase::limit(natural limit) {
 	this->maxlimit = limit;
 	this->offset = 0;
@@ -328,6 +507,35 @@ QueryBase& QueryBase::stale() {
 QueryBase::QueryBase(const QueryBase& other)
 	:json(other.json)
 {
+	copyFrom(other);
+}
+
+QueryBase::QueryBase(const QueryBase& other, const Json &json)
+	:json(json)
+{
+	copyFrom(other);
+}
+
+void QueryBase::copyFrom(const QueryBase& other) {
+	curKeySet = other.curKeySet;
+	startkey = other.startkey;
+	endkey = other.endkey;
+	if (other.keys != null) {
+		//keys are extended by selectKey(), so copy must not share the container
+		keys = json.array();
+		for (natural i = 0, cnt = other.keys.length(); i < cnt; i++) keys.add(other.keys[i]);
+	}
+	mode = other.mode;
+	staleMode = other.staleMode;
+	groupLevel = other.groupLevel;
+	offset = other.offset;
+	maxlimit = other.maxlimit;
+	descent = other.descent;
+	offset_doc = other.offset_doc;
+	forceArray = other.forceArray;
+	projection = other.projection;
+	args = other.args;
+	viewFlags = other.viewFlags;
 }
 
 
@@ -419,10 +627,323 @@ JSON::Value QueryBase::initArgs() {
 QueryBase::~QueryBase() {
 }
 
-Query::Query(CouchDB &db, const View &view):QueryBase(db.json,view.flags),db(db),viewDefinition(view) {
+namespace {
+
+struct JoinSlot {
+	AutoArray<natural> rows;
+	ConstValue value;
+	Container values;
+};
+
+}
+
+Result Result::joinAll(ConstStringT<JoinDef> joins) const {
+
+	natural cnt = length();
+	AutoArray<Container> rows;
+	AutoArray<bool> keep;
+	rows.reserve(cnt);
+	keep.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		rows.add((*this)[i]->copy(json.factory,1));
+		keep.add(true);
+	}
+
+	for (natural j = 0; j < joins.length(); j++) {
+		const JoinDef &def = joins[j];
+		bool missingRows = (def.flags & joinMissingRows) != 0;
+		natural mode = def.flags & 0x3;
+		typedef std::unordered_map<std::string, JoinSlot> SlotMap;
+		SlotMap slots;
+
+		QueryBase &q = *def.query;
+		q.reset();
+
+		for (natural i = 0; i < cnt; i++) {
+			if (!keep[i]) continue;
+			ConstValue fk = def.bindFn(rows[i]);
+			if (fk == null) {
+				if (!missingRows) keep(i) = false;
+				continue;
+			}
+			//binary sort key normalizes numbers, so 5 and 5.0 are the same key as on the server
+			std::pair<SlotMap::iterator, bool> ins = slots.insert(
+					SlotMap::value_type(makeSortKey(fk), JoinSlot()));
+			if (ins.second) q.selectKey(fk);
+			ins.first->second.rows.add(i);
+		}
+
+		//query without keys would return whole view
+		if (!slots.empty()) {
+			Result lookup = q.exec();
+			while (lookup.hasItems()) {
+				Row row(lookup.getNext());
+				if (row.key == null) continue;
+				SlotMap::iterator iter = slots.find(makeSortKey(row.key));
+				if (iter == slots.end()) continue;
+				JoinSlot &slot = iter->second;
+				switch (mode) {
+				case joinLastRow: slot.value = row.value;break;
+				case joinAllRows: if (slot.values == null) slot.values = json.array();
+								  slot.values.add(row.value);
+								  break;
+				default: if (slot.value == null) slot.value = row.value;break;
+				}
+			}
+		}
+
+		for (SlotMap::iterator iter = slots.begin(); iter != slots.end(); ++iter) {
+			const JoinSlot &slot = iter->second;
+			ConstValue v = mode == joinAllRows?ConstValue(slot.values):slot.value;
+			for (natural k = 0; k < slot.rows.length(); k++) {
+				natural idx = slot.rows[k];
+				if (v != null) rows(idx).set(def.name, v);
+				else if (!missingRows) keep(idx) = false;
+			}
+		}
+	}
+
+	AutoArray<ConstValue> output;
+	output.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		if (keep[i]) output.add(rows[i]);
+	}
+	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(output));
+	return Result(json,json("rows",newrows));
+}
+
+void Result::sortRowsByKey(const KeyFunction &keyFn, bool descending, natural threads,
+							AutoArray<ConstValue> &rows, AutoArray<std::string> *keys) const {
+	natural cnt = length();
+	std::vector<SortKeyItem> items;
+	items.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		items.push_back(SortKeyItem(makeSortKey(keyFn((*this)[i])), i));
+	}
+	if (threads == 0) {
+		//small results are not worth to start threads
+		threads = cnt / 65536 + 1;
+		if (threads > 8) threads = 8;
+	}
+	sortKeyItems(items, threads, descending);
+	rows.reserve(cnt);
+	if (keys) keys->reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		const SortKeyItem &itm = items[i];
+		rows.add((*this)[itm.index]);
+		if (keys) keys->add(itm.key);
+	}
+}
+
+Result Result::sortByKey(const KeyFunction &keyFn, bool descending, natural threads) const {
+	AutoArray<ConstValue> rows;
+	sortRowsByKey(keyFn, descending, threads, rows, 0);
+	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(rows));
+	return Result(json,json("rows",newrows)("total_rows",total)("offset",offset));
+}
+
+Result Result::groupByKey(const KeyFunction &keyFn, const ReduceFunction &reduceFn, bool descending, natural threads) const {
+	AutoArray<ConstValue> rows;
+	AutoArray<std::string> keys;
+	sortRowsByKey(keyFn, descending, threads, rows, &keys);
+	AutoArray<ConstValue> output;
+	natural cnt = rows.length();
+	natural startPos = 0;
+	for (natural i = 1; i <= cnt; i++) {
+		if (i == cnt || keys[i] != keys[startPos]) {
+			ConstValue res = reduceFn(rows.mid(startPos, i-startPos));
+			if (res != null) output.add(res);
+			startPos = i;
+		}
+	}
+	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(output));
+	return Result(json,json("rows",newrows));
+}
+
+Result Result::groupSorted(natural level, const ReduceFunction &reduceFn) const {
+	AutoArray<ConstValue> output;
+	GroupAggregator agg(level, reduceFn, [&](const ConstValue &row) {
+		output.add(row);
+	});
+	for (natural i = 0, cnt = this->length(); i < cnt; i++) {
+		agg.add((*this)[i]);
+	}
+	agg.finish();
+	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(output));
+	return Result(json,json("rows",newrows));
+}
+
+namespace {
+
+///Loser tree (tournament tree) used to merge ordered results
+class MergeLoserTree {
+public:
+	MergeLoserTree(ConstStringT<Result> results, const Result::KeyFunction &keyFn)
+		:results(results),keyFn(keyFn),k(results.length()),pos(k,0),keys(k),exhausted(k,false),tree(k,k) {
+		for (natural i = 0; i < k; i++) loadKey(i);
+		//virtual leaf k is smaller than anything, it is pushed out by the real leaves
+		for (natural i = k; i > 0; i--) adjust(i-1);
+	}
+
+	bool empty() const {return k == 0 || exhausted[tree[0]];}
+	natural top() const {return tree[0];}
+	const std::string &topKey() const {return keys[tree[0]];}
+	ConstValue topRow() const {return results[tree[0]][pos[tree[0]]];}
+
+	void pop() {
+		natural w = tree[0];
+		pos[w]++;
+		loadKey(w);
+		adjust(w);
+	}
+
+protected:
+	ConstStringT<Result> results;
+	const Result::KeyFunction &keyFn;
+	natural k;
+	std::vector<natural> pos;
+	std::vector<std::string> keys;
+	std::vector<bool> exhausted;
+	std::vector<natural> tree;
+
+	void loadKey(natural i) {
+		if (pos[i] < results[i].length()) {
+			ConstValue row = results[i][pos[i]];
+			keys[i] = makeSortKey(keyFn?keyFn(row):row["key"]);
+		} else {
+			exhausted[i] = true;
+			keys[i].clear();
+		}
+	}
+
+	bool beats(natural a, natural b) const {
+		if (a == k) return true;
+		if (b == k) return false;
+		if (exhausted[a]) return false;
+		if (exhausted[b]) return true;
+		int c = keys[a].compare(keys[b]);
+		if (c != 0) return c < 0;
+		return a < b;
+	}
+
+	void adjust(natural s) {
+		for (natural t = (s + k) / 2; t > 0; t /= 2) {
+			if (beats(tree[t], s)) std::swap(s, tree[t]);
+		}
+		tree[0] = s;
+	}
+};
+
+}
+
+Result Result::mergeMany(const Json &json, ConstStringT<Result> results, MergeType type, const KeyFunction &keyFn) {
+
+	MergeLoserTree lt(results, keyFn);
+	natural k = results.length();
+	AutoArray<ConstValue> output;
+	AutoArray<ConstValue> group;
+	std::vector<bool> present(k, false);
+
+	while (!lt.empty()) {
+		//collect group of rows with the same key
+		std::string key = lt.topKey();
+		natural sources = 0;
+		bool inFirst = false;
+		group.clear();
+		for (natural i = 0; i < k; i++) present[i] = false;
+		while (!lt.empty() && lt.topKey() == key) {
+			natural src = lt.top();
+			if (!present[src]) {
+				present[src] = true;
+				sources++;
+			}
+			if (src == 0) inFirst = true;
+			if (type == mergeUnion || type == mergeSymDiff || src == 0)
+				group.add(lt.topRow());
+			lt.pop();
+		}
+
+		bool emit;
+		switch (type) {
+		case mergeIntersection: emit = sources == k;break;
+		case mergeSymDiff: emit = sources == 1;break;
+		case mergeMinus: emit = inFirst && sources == 1;break;
+		default: emit = true;break;
+		}
+		if (emit) {
+			for (natural i = 0; i < group.length(); i++) output.add(group[i]);
+		}
+	}
+
+	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(output));
+	return Result(json,json("rows",newrows));
+}
+
+Query::Query(CouchDB &db, const View &view):QueryBase(db.json,view.flags),db(db),viewDefinition(view)
+	,chunkSize(naturalNull),chunkPool(0),chunkParallel(4) {
+}
+
+Query::Query(const Query& other):QueryBase(other),db(other.db),viewDefinition(other.viewDefinition)
+	,chunkSize(other.chunkSize),chunkPool(other.chunkPool),chunkParallel(other.chunkParallel)
+	,partitionKey(other.partitionKey) {
+}
+
+Query::Query(const Query& other, CouchDB &db):QueryBase(other, db.json),db(db),viewDefinition(other.viewDefinition)
+	,chunkSize(other.chunkSize),chunkPool(other.chunkPool),chunkParallel(other.chunkParallel)
+	,partitionKey(other.partitionKey) {
 }
 
-Query::Query(const Query& other):QueryBase(other),db(other.db),viewDefinition(other.viewDefinition) {
+JSON::ConstValue Query::parseArgValue(ConstStrA value) const {
+	//arguments are written to the URL as they are, so numbers and booleans must keep their type
+	try {
+		return json.factory->fromString(value);
+	} catch (const Exception &) {
+		return json(value);
+	}
+}
+
+JSON::ConstValue Query::getQueryObject() const {
+	finishCurrent();
+
+	Container q = json.object();
+	if (groupLevel==naturalNull) q.set("reduce",json(false));
+	else if (keys == null || keys->length() == 1) q.set("group_level",json(groupLevel));
+	else q.set("group",json(groupLevel > 0));
+
+	if (descent) q.set("descending",json(true));
+	if (viewDefinition.flags & View::includeDocs) q.set("include_docs",json(true));
+	if (offset) q.set("skip",json(offset));
+	if (maxlimit!=naturalNull) q.set("limit",json(maxlimit));
+	if (!offset_doc.empty()) q.set("startkey_docid",json(offset_doc));
+	if (viewDefinition.flags & View::updateSeq) q.set("update_seq",json(true));
+	if (viewDefinition.flags & View::exludeEnd) q.set("inclusive_end",json(false));
+
+	for (natural i = 0, cnt = viewDefinition.args.length(); i < cnt; i++) {
+		if (args == null || args->getPtr(viewDefinition.args[i].key) == 0)
+			q.set(viewDefinition.args[i].key,parseArgValue(viewDefinition.args[i].value));
+	}
+	if (args != null) {
+		for (JSON::Iterator iter = args->getFwIter(); iter.hasItems();) {
+			const JSON::KeyValue &kv = iter.getNext();
+			q.set(kv.getStringKey(),kv);
+		}
+	}
+
+	switch (staleMode) {
+	case smUpdate:break;
+	case smUpdateAfter: q.set("stale",json(ConstStrA("update_after")));break;
+	case smStale: q.set("stale",json(ConstStrA("ok")));break;
+	}
+
+	if (keys == nil) {
+		if (startkey != nil) q.set(descent?"endkey":"startkey",startkey);
+		if (endkey != nil) q.set(descent?"startkey":"endkey",endkey);
+	} else if (keys->length() == 1) {
+		q.set("key",keys[0]);
+	} else {
+		q.set("keys",keys);
+	}
+	return q;
 }
 
 Query::~Query() {
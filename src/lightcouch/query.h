@@ -14,7 +14,11 @@
 #include "lightspeed/base/containers/string.h"
 #include <lightspeed/utils/json/json.h>
 
+#include <functional>
+#include <string>
+#include <lightspeed/base/streams/fileio.h>
 #include "view.h"
+#include "jsonPull.h"
 
 #include "object.h"
 
@@ -22,6 +26,10 @@
 namespace LightCouch {
 
 class CouchDB;
+class CouchDBPool;
+template<typename T> class RowBinding;
+class CancelToken;
+struct QueryProfile;
 class View;
 class Result;
 
@@ -209,9 +217,26 @@ public:
 	 */
 	QueryBase &reverseOrder();
 
+	///Determines whether results are returned in reversed order
+	bool isDescending() const {return descent;}
+
 	template<typename T>
 	QueryBase &arg(ConstStrA key, T value);
 
+	///Keeps only selected fields of the rows
+	/**
+	 * Function can be called multiple times to select multiple fields. The response is
+	 * parsed by a streaming parser which skips all fields that are not selected without allocating them.
+	 * This is useful especially with View::includeDocs, when only few fields of the documents are needed.
+	 *
+	 * @param path dot separated path relative to the row, for example "doc.name" or "value.0". Fields "id"
+	 * and "key" are always kept.
+	 * @return reference to the query to create chain
+	 *
+	 * @note Projected results are not stored in the cache
+	 */
+	QueryBase &project(ConstStrA path);
+
 	///Execute query and return the result
 	/**
 	 * @return result of query. You can pass the result to the Result object.
@@ -229,6 +254,9 @@ public:
 protected:
 
 
+	///Copies the query using different json builder
+	QueryBase(const QueryBase &other, const Json &json);
+
 	mutable AutoArray<JSON::ConstValue,SmallAlloc<9> > curKeySet;
 	mutable JSON::ConstValue startkey, endkey;
 	mutable JSON::Container keys;
@@ -252,6 +280,7 @@ protected:
 	bool descent;
 	StringA offset_doc;
 	bool forceArray;
+	AutoArray<StringA> projection;
 
 
 
@@ -269,7 +298,8 @@ protected:
 
 
 
-	void finishCurrent() const;;
+	void finishCurrent() const;
+	void copyFrom(const QueryBase &other);
 	JSON::Value initArgs();
 	static void appendCustomArg(UrlFormatter &fmt, ConstStrA key, ConstStrA value) ;
 	void appendCustomArg(UrlFormatter &fmt, ConstStrA key, const JSON::INode * value ) const;
@@ -307,10 +337,141 @@ class Query: public QueryBase {
 public:
 	Query(CouchDB &db, const View &view);
 	Query(const Query &other);
+	///Copies the query and binds it to other database connection
+	/**
+	 * @param other source query
+	 * @param db database connection used to execute the copy. Useful to execute the
+	 * query through the connection acquired from the CouchDBPool
+	 */
+	Query(const Query &other, CouchDB &db);
 	virtual ~Query();
 
 	virtual Result exec() const override;
 
+	///Executes query, the request can be canceled
+	/**
+	 * @param token cancel token. When it is canceled or its deadline expires, the request is
+	 * aborted and the CanceledException (or DeadlineExceededException) is thrown. The token is also
+	 * applied to the connections used to execute chunks (see splitKeys())
+	 * @return result
+	 */
+	Result exec(const CancelToken &token) const;
+
+	///Executes query and records the timing breakdown
+	/**
+	 * Helps to find, whether the slow query is caused by the view on the server or by
+	 * processing of the result on the client.
+	 *
+	 * @param profile profile which receives the timing. Values are added to the values already stored
+	 * in the profile, so the profile can collect multiple queries.
+	 * @return result
+	 *
+	 * @note the body of the response is read into the memory before it is parsed while the query is
+	 * profiled. Queries with projection (see project()) record only the total time
+	 */
+	Result execProfiled(QueryProfile &profile) const;
+
+	///Executes query and decodes rows directly into the C++ objects
+	/**
+	 * The response is parsed by a streaming parser, the fields of the rows are
+	 * stored directly to the objects according to the binding. Unbound parts of the rows are
+	 * skipped without building JSON tree.
+	 *
+	 * @param binding describes which fields of the row are stored into which members of the object
+	 * @return array of decoded rows
+	 *
+	 * @note Result is not cached and the postprocessing function of the view is not called. Key
+	 * splitting (splitKeys()) is not applied. Template is defined in rowBinding.h
+	 */
+	template<typename T>
+	AutoArray<T> exec(const RowBinding<T> &binding) const;
+
+	///Function which receives rows of the streamed response
+	typedef std::function<void(const ConstValue &)> RowFn;
+
+	///Executes query and passes the rows to the function while the response is parsed
+	/**
+	 * Only one row is held in the memory at time.
+	 *
+	 * @param rowFn function called for every row
+	 *
+	 * @note Result is not cached and the postprocessing function of the view is not called.
+	 */
+	void streamRows(const RowFn &rowFn) const;
+
+	///Parser of the streamed response
+	typedef JsonPullParser<SeqFileInput> RowParser;
+	///Function which receives rows of the streamed response as tokens
+	/**
+	 * The function receives the parser and the first token of the row. It must consume
+	 * whole row (for example, by calling RowParser::skipValue or RowParser::parseValue)
+	 */
+	typedef std::function<void(RowParser &, RowParser::Token)> RowTokenFn;
+	///Function which receives other top-level fields of the streamed response
+	/**
+	 * The function receives the parser, name of the field (total_rows, offset, etc) and the
+	 * first token of its value. It must consume whole value
+	 */
+	typedef std::function<void(RowParser &, ConstStrA, RowParser::Token)> FieldTokenFn;
+
+	///Executes query and passes the rows to the function directly from the parser
+	/**
+	 * All streaming functions (streamRows(), exec(RowBinding), ViewExporter, ColumnarResult)
+	 * are built on this function. Rows are not converted to JSON unless the function does it.
+	 *
+	 * @param rowFn function called for every row
+	 * @param fieldFn optional function called for other top-level fields of the response. If
+	 * not specified, the fields are skipped
+	 *
+	 * @note Result is not cached and the postprocessing function of the view is not called.
+	 */
+	void streamTokens(const RowTokenFn &rowFn, const FieldTokenFn &fieldFn = FieldTokenFn()) const;
+
+	///Splits large set of keys into chunks
+	/**
+	 * Query with many keys creates one huge request, which can be slow to process or can
+	 * exceed the limit of the length of the URL. When the count of keys exceeds the chunk size,
+	 * the query is split into multiple requests. Rows are reassembled in the original order
+	 * of the keys, so the result is the same as if the query has been executed at once.
+	 *
+	 * @param chunkSize maximum count of keys per request. Set 0 to disable splitting (default)
+	 * @param pool optional pool of connections. If specified, chunks are executed in parallel
+	 * (the connections are switched to the database of the query). Otherwise
+	 * chunks are executed one by one through the connection of the query
+	 * @param maxParallel maximum count of chunks executed at the same time
+	 * @return reference to this object
+	 *
+	 * @note The splitting is not applied if the query has the limit or the offset, because these are
+	 * applied to the whole result. It is also not applied to the reduce without grouping (group level 0),
+	 * because the server reduces all keys into the single row. Setting is not cleared by reset()
+	 */
+	Query &splitKeys(natural chunkSize, CouchDBPool *pool = 0, natural maxParallel = 4);
+
+	///Retrieves the query as JSON object
+	/**
+	 * @return object which contains all arguments of the query (keys, range, limit, etc). The object
+	 * can be sent in the body of the POST request to the view. It is used by the QueryBatch
+	 */
+	JSON::ConstValue getQueryObject() const;
+
+	///Retrieves definition of the view
+	const View &getView() const {return viewDefinition;}
+
+	///Restricts the query to one partition of the partitioned database
+	/**
+	 * The query is sent to the endpoint _partition/{partition}/<view>, which is served by a single
+	 * shard (CouchDB 3.0+). The view must be defined in the partitioned design document
+	 *
+	 * @param partitionKey partition key. Set empty string to query whole database
+	 * @return reference to this object
+	 *
+	 * @note Setting is not cleared by reset()
+	 */
+	Query &partition(ConstStrA partitionKey);
+
+	///Retrieves path of the request including the partition
+	StringA getRequestPath() const;
+
 protected:
 	CouchDB &db;
 	View viewDefinition;
@@ -318,6 +479,33 @@ protected:
 	CouchDB &getDatabase() {return db;}
 	const CouchDB &getDatabase() const {return db;}
 
+	///Writes path of the view and all arguments except keys to the url line
+	/**
+	 * @param out output buffer
+	 * @param multiKey true, if the query will select multiple keys
+	 */
+	void buildUrlPrefix(UrlLine &out, bool multiKey) const;
+
+	natural chunkSize;
+	CouchDBPool *chunkPool;
+	natural chunkParallel;
+	StringA partitionKey;
+
+	ConstValue execRequest(CouchDB &db, const Json &json, UrlLine &urlline, const ConstValue &keys, bool multiKey = false) const;
+	///Builds url of the request. Returns body of the POST request or null for the GET request
+	/**
+	 * @param multiKey use the multi-key form (group=true&keys) even for single key. The chunks
+	 * of the split query need it, otherwise the single key chunk would be grouped by the group level
+	 */
+	ConstValue buildRequest(const Json &json, UrlLine &urlline, const ConstValue &keys, bool multiKey = false) const;
+	ConstValue execChunked() const;
+	///Converts value of the custom argument to JSON, invalid JSON is kept as string
+	ConstValue parseArgValue(ConstStrA value) const;
+
+	friend class PreparedQuery;
+	friend class QueryBatch;
+	friend class ReduceCache;
+	friend class PagedResult;
 };
 
 
@@ -433,6 +621,40 @@ public:
 	template<typename BindFn>
 	Result join(QueryBase &q, ConstStrA name, natural flags, BindFn bindFn);
 
+	///Bind function used by the joinAll()
+	typedef std::function<ConstValue(const ConstValue &)> BindFunction;
+
+	///Definition of single join for the function joinAll()
+	struct JoinDef {
+		///query to the other view
+		QueryBase *query;
+		///name of the field, where the joined value is put
+		StringA name;
+		///combination of flags joinFirstRow, joinLastRow, joinAllRows, joinMissingRows
+		natural flags;
+		///bind function, see join()
+		BindFunction bindFn;
+
+		JoinDef(QueryBase &query, StringA name, natural flags, const BindFunction &bindFn)
+			:query(&query),name(name),flags(flags),bindFn(bindFn) {}
+	};
+
+	///Performs multiple joins in one pass
+	/**
+	 * Rows are copied only once and all joins are applied to the same copy. The joins
+	 * are processed in the order of definition, so the bind function of the next join can use
+	 * the field created by the previous join.
+	 *
+	 * Foreign keys are hashed using their canonical JSON representation, every key is
+	 * requested only once. To send lookups in chunks in parallel, configure the query
+	 * by the function Query::splitKeys().
+	 *
+	 * @param joins definitions of the joins
+	 * @return combined result. Rows are in the original order. A row, which has no match in
+	 * any join without the flag joinMissingRows, is removed
+	 */
+	Result joinAll(ConstStringT<JoinDef> joins) const;
+
 	///Sorts result
 	/** Function orders rows by compare function
 	 *
@@ -488,6 +710,51 @@ public:
 	template<typename CmpFn, typename ReduceFn>
 	Result group(CmpFn compareRowsFunction, ReduceFn reduceFn, bool descending = false) const;
 
+	///Function which extracts the value used to order the row
+	typedef std::function<ConstValue(const ConstValue &)> KeyFunction;
+	///Function which reduces group of rows into single row (see group())
+	typedef std::function<ConstValue(const ConstStringT<ConstValue> &)> ReduceFunction;
+
+	///Sorts result by a key extracted from every row
+	/**
+	 * In contrast to sort(), the key function is called only once per row. Extracted key
+	 * is converted to the binary sort key (see appendSortKey()), rows are then sorted
+	 * by comparing these keys. Rows are ordered by CouchDB's collation of the extracted keys. Sorting
+	 * is stable.
+	 *
+	 * @param keyFn function which extracts the key from the row. For example, it can
+	 * return the value or a field of the document.
+	 * @param descending set true to reverse ordering
+	 * @param threads count of threads used to sort. Set 0 to choose count by size of the result
+	 * @return sorted result
+	 */
+	Result sortByKey(const KeyFunction &keyFn, bool descending = false, natural threads = 0) const;
+
+	///Aggregates groups of rows with the same key
+	/**
+	 * Function works as group(), but the rows are ordered and grouped by the key extracted
+	 * by the function keyFn. See sortByKey()
+	 *
+	 * @param keyFn function which extracts the key from the row.
+	 * @param reduceFn function which reduces rows with the same key. It can return null to skip the group
+	 * @param descending set true to reverse ordering
+	 * @param threads count of threads used to sort. Set 0 to choose count by size of the result
+	 * @return new result
+	 */
+	Result groupByKey(const KeyFunction &keyFn, const ReduceFunction &reduceFn, bool descending = false, natural threads = 0) const;
+
+	///Aggregates groups of rows of the result which is already ordered by the key
+	/**
+	 * Rows of the view are ordered by the key, so the groups are detected without sorting. Only
+	 * rows of the current group are collected. See GroupAggregator, which can group rows of the streamed response
+	 *
+	 * @param level count of the components of the key which form the group. If the key is
+	 * not an array, whole key is used. Use naturalNull to group by whole key
+	 * @param reduceFn function which reduces rows of the group. It can return null to skip the group
+	 * @return new result
+	 */
+	Result groupSorted(natural level, const ReduceFunction &reduceFn) const;
+
 
 
 	///Merges two results into one
@@ -520,10 +787,32 @@ public:
 	template<typename MergeFn>
 	Result merge(const Result &other, MergeFn mergeFn) const;
 
+	///Merges many ordered results into one
+	/**
+	 * Performs k-way merge using a loser tree, so each output row costs O(log k) comparisons. The
+	 * keys are compared as binary sort keys (see appendSortKey()), so the order follows CouchDB's collation
+	 * including the ICU order of the strings. Results returned by the views can be merged directly.
+	 *
+	 * @param json json builder used to create the result
+	 * @param results results to merge. Every result must be ordered by the key in the ascending order
+	 * @param type merge type. Rows with equal keys form a group, the type determines, which groups are emitted
+	 *  - mergeUnion - all rows of all groups. Rows with equal keys are ordered by index of the result
+	 *  - mergeIntersection - rows from the first result, if the key exists in all results
+	 *  - mergeSymDiff - rows of the groups, where the key exists in exactly one result
+	 *  - mergeMinus - rows from the first result, if the key doesn't exist in any other result
+	 * @param keyFn function which extracts the key from the row. If not specified, the field "key" is used
+	 * @return merged result
+	 */
+	static Result mergeMany(const Json &json, ConstStringT<Result> results, MergeType type = mergeUnion,
+			const KeyFunction &keyFn = KeyFunction());
+
 protected:
 
 	Json json;
 	natural rdpos;
+
+	void sortRowsByKey(const KeyFunction &keyFn, bool descending, natural threads, AutoArray<ConstValue> &rows, AutoArray<std::string> *keys) const;
+
 	natural total;
 	natural offset;
 	mutable ConstValue out;
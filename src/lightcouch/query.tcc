@@ -86,7 +86,7 @@ inline Result LightCouch::Result::merge(const Result& other, MergeFn mergeFn) co
 
 	while (leftPos < leftCnt && rightPos < rightCnt) {
 		ConstValue left = (*this)[leftPos];
-		ConstValue right = (*this)[rightPos];
+		ConstValue right = other[rightPos];
 		ConstValue res = mergeFn(left,right);
 		if (res == left) {
 			leftPos++;
@@ -109,7 +109,7 @@ inline Result LightCouch::Result::merge(const Result& other, MergeFn mergeFn) co
 		}
 	}
 	while (rightPos < rightCnt) {
-		ConstValue right = (*this)[rightPos];
+		ConstValue right = other[rightPos];
 		ConstValue res = mergeFn(null,right);
 			rightPos++;
 		if (res != null) {
@@ -124,88 +124,11 @@ inline Result LightCouch::Result::merge(const Result& other, MergeFn mergeFn) co
 template<typename BindFn>
 inline Result LightCouch::Result::join(QueryBase& q, ConstStrA name, natural flags,  BindFn bindFn)
 {
-	typedef MultiMap<ConstValue, Container, JsonIsLess> ResultMap;
-	ResultMap map;
-
-	q.reset();
-
-	natural cnt = length();
-	for (natural i = 0; i < cnt; i++) {
-		ConstValue row = (*this)[i];
-		ConstValue fk = bindFn(row);
-		ResultMap::ValueList &rows = map(fk);
-		if (rows.empty()) {
-			q.selectKey(fk);
-		}
-		Container newrow = row->copy(json.factory,1);
-
-	}
-
-	AutoArray<ConstValue> output;
-
-	Result fklookup = q.exec();
-
-	while (fklookup.hasItems()) {
-		ConstValue row = fklookup.getNext();
-		ConstValue key = row["key"];
-		ConstValue value = row["value"];
-		ResultMap::ListIter list = map.find(key);
-		switch (flags & 0x3) {
-		case joinFirstRow: {
-			Container k = list.getNext();
-			if (k[name] != null) continue;
-			k.set("name", value);
-			while (list.hasItems()) {
-				Container(list.getNext()).set(name, value);
-			}
-		}
-		break;
-		case joinLastRow: {
-			while (list.hasItems()) {
-				Container(list.getNext()).set(name, value);
-			}
-		}
-		break;
-		case joinAllRows: {
-			Container k = list.getNext();
-			Container values;
-			ConstValue curv = k[name];
-			if (curv != null) {
-				ConstValue cont = k[name];
-				values = static_cast<Container &>(cont);
-			}
-			else {
-				values = json.array();
-				k.set(name, values);
-				while (list.hasItems()) {
-					Container(list.getNext()).set(name, value);
-				}
-			}
-			values.add(value);
-		}
-		break;
-		}
-	}
-
-	if (flags & joinMissingRows) {
-		for (auto iter = map.getFwIter(); iter.hasItems();) {
-			output.add(iter.getNext().value);
-		}
-	} else {
-		for (auto iter = map.getFwIter(); iter.hasItems();) {
-			const ResultMap::KeyValue &kv = iter.getNext();
-			if (kv.value[name] != null) {
-				output.add(kv.value);
-			}
-		}
-
-	}
-	JSON::ConstValue newrows = json.factory->newValue(ConstStringT<ConstValue>(output));
-	return Result(json,json("rows",newrows));
+	JoinDef def(q, name, flags, bindFn);
+	return joinAll(ConstStringT<JoinDef>(&def,1));
 }
 
 
-
 }
 
 
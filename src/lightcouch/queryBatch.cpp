@@ -0,0 +1,131 @@
+/*
+ * queryBatch.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "queryBatch.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+
+#include "couchDB.h"
+#include "couchDBPool.h"
+#include "exception.h"
+
+namespace LightCouch {
+
+QueryBatch::QueryBatch(CouchDB& db, CouchDBPool* pool, natural maxParallel)
+	:db(db),pool(pool),maxParallel(maxParallel),batchSupported(true)
+{
+}
+
+natural QueryBatch::add(const Query& q) {
+	queries.add(q);
+	return queries.length()-1;
+}
+
+void QueryBatch::clear() {
+	queries.clear();
+}
+
+AutoArray<Result> QueryBatch::exec() {
+	natural cnt = queries.length();
+	AutoArray<ConstValue> results;
+	AutoArray<bool> done;
+	results.reserve(cnt);
+	done.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		results.add(ConstValue());
+		done.add(false);
+	}
+
+	for (natural i = 0; i < cnt; i++) {
+		if (done[i]) continue;
+		//collect all queries for the same view of the same database sent through the same connection
+		CouchDB &conn = queries[i].db;
+		StringA dbName = conn.getCurrentDB();
+		StringA viewPath = queries[i].getRequestPath();
+		AutoArray<natural> indexes;
+		for (natural j = i; j < cnt; j++) {
+			if (!done[j] && &queries[j].db == &conn
+					&& queries[j].db.getCurrentDB() == dbName
+					&& queries[j].getRequestPath() == viewPath) {
+				indexes.add(j);
+				done(j) = true;
+			}
+		}
+
+		if (batchSupported && indexes.length() > 1) {
+			try {
+				execBatch(conn, viewPath, indexes, results);
+				continue;
+			} catch (const RequestError &e) {
+				natural status = e.getStatus();
+				if (status != 400 && status != 404 && status != 405) throw;
+				//400 can be caused by the content of this batch, so the endpoint is tried again next time
+				if (status != 400) batchSupported = false;
+			}
+		}
+		execSeparately(indexes, results);
+	}
+
+	AutoArray<Result> out;
+	out.reserve(cnt);
+	for (natural i = 0; i < cnt; i++) {
+		out.add(Result(db.json, results[i]));
+	}
+	return out;
+}
+
+void QueryBatch::execBatch(CouchDB &conn, ConstStrA viewPath, ConstStringT<natural> indexes, AutoArray<ConstValue>& results) {
+	Container qs = conn.json.array();
+	for (natural i = 0; i < indexes.length(); i++) {
+		qs.add(queries[indexes[i]].getQueryObject());
+	}
+	StringA path = viewPath + ConstStrA("/queries");
+	ConstValue resp = conn.requestPOST(path, conn.json("queries",qs));
+	ConstValue res = resp["results"];
+	for (natural i = 0; i < indexes.length(); i++) {
+		results(indexes[i]) = finish(queries[indexes[i]], res[i]);
+	}
+}
+
+static ConstValue resultToResponse(CouchDB &db, const Result &r) {
+	return db.json("rows",static_cast<const ConstValue &>(r))
+			("total_rows",r.getTotal())
+			("offset",r.getOffset());
+}
+
+void QueryBatch::execSeparately(ConstStringT<natural> indexes, AutoArray<ConstValue>& results) {
+	if (pool == 0 || indexes.length() < 2) {
+		//requests are sent through the same keep-alive connection
+		for (natural i = 0; i < indexes.length(); i++) {
+			const Query &q = queries[indexes[i]];
+			results(indexes[i]) = resultToResponse(q.db, q.exec());
+		}
+	} else {
+		pool->parallel(indexes.length(), maxParallel, [&](CouchDB &c, natural i) {
+			const Query &src = queries[indexes[i]];
+			StringA prevDb = c.getCurrentDB();
+			c.use(src.db.getCurrentDB());
+			try {
+				Query q(src, c);
+				results(indexes[i]) = resultToResponse(c, q.exec());
+			} catch (...) {
+				c.use(prevDb);
+				throw;
+			}
+			c.use(prevDb);
+		});
+	}
+}
+
+ConstValue QueryBatch::finish(const Query& q, ConstValue result) {
+	if (q.viewDefinition.postprocess) {
+		result = q.viewDefinition.postprocess(&q.db, q.args, result);
+	}
+	return result;
+}
+
+} /* namespace LightCouch */
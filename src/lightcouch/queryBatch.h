@@ -0,0 +1,97 @@
+/*
+ * queryBatch.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_QUERYBATCH_H_
+#define LIGHTCOUCH_QUERYBATCH_H_
+
+#include "lightspeed/base/containers/autoArray.h"
+
+#include "query.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDBPool;
+
+///Executes multiple queries in one request
+/**
+ * The queries are collected and sent to the server in one POST request to the endpoint
+ * <view>/queries, which is supported by CouchDB 2.2+. Queries for the same view of the same
+ * database are sent together through the connection of the first such query, so the count
+ * of requests equals to count of distinct views in the batch.
+ *
+ * If the server rejects the batch (it responds with status 400, 404 or 405), the queries
+ * are executed one by one through the same connection, or in parallel through the pool, if it is
+ * available. The pooled connections are switched to the database of each query. The object
+ * remembers that the endpoint is not supported (404, 405) and doesn't try it again. The status 400
+ * affects the current call only.
+ *
+ * @code
+ * QueryBatch batch(db);
+ * Query q1(db.createQuery(by_name));
+ * Query q2(db.createQuery(by_age));
+ * batch.add(q1.select("Kermit Byrd"));
+ * batch.add(q2.from(20).to(40));
+ * AutoArray<Result> res = batch.exec();
+ * @endcode
+ */
+class QueryBatch {
+public:
+
+	///Construct the batch
+	/**
+	 * @param db connection used to build the results. The batches are sent through the
+	 * connections of the queries
+	 * @param pool optional pool of connections, which is used for parallel
+	 * execution when the server doesn't support the batch endpoint
+	 * @param maxParallel maximum count of parallel requests, when pool is used
+	 */
+	QueryBatch(CouchDB &db, CouchDBPool *pool = 0, natural maxParallel = 4);
+
+	///Adds query to the batch
+	/**
+	 * @param q query. The query is copied, so it can be reset and reused immediately
+	 * @return index of the result in the array returned by exec()
+	 */
+	natural add(const Query &q);
+
+	///Executes all queries
+	/**
+	 * @return results in the same order as queries have been added
+	 */
+	AutoArray<Result> exec();
+
+	///Removes all queries from the batch
+	void clear();
+
+	///Returns count of queries in the batch
+	natural length() const {return queries.length();}
+
+	///Determines whether batch endpoint is used.
+	/** It is true until the server reports that the batch endpoint is not supported */
+	bool isBatchSupported() const {return batchSupported;}
+
+	///Disables the batch endpoint, queries are always executed separately
+	/** Use for servers or proxies, which don't handle the endpoint correctly */
+	void disableBatch() {batchSupported = false;}
+
+protected:
+	CouchDB &db;
+	CouchDBPool *pool;
+	natural maxParallel;
+	bool batchSupported;
+	AutoArray<Query> queries;
+
+	void execBatch(CouchDB &conn, ConstStrA viewPath, ConstStringT<natural> indexes, AutoArray<ConstValue> &results);
+	void execSeparately(ConstStringT<natural> indexes, AutoArray<ConstValue> &results);
+	ConstValue finish(const Query &q, ConstValue result);
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_QUERYBATCH_H_ */
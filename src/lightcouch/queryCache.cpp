@@ -10,9 +10,36 @@
 #include "lightspeed/base/sync/synchronize.h"
 #include "lightspeed/base/actions/promise.tcc"
 #include "lightspeed/base/containers/map.tcc"
+#include "lightspeed/base/containers/sort.tcc"
+#include "lightspeed/base/containers/autoArray.tcc"
+#include "lightspeed/base/streams/fileio.h"
+#include <lightspeed/utils/json/jsonserializer.tcc>
+
+#include "couchDBPool.h"
+
+#include <chrono>
 
 namespace LightCouch {
 
+natural QueryCache::estimateSize(const ConstValue &v) {
+	natural sz = 4*sizeof(void *);
+	switch (v->getType()) {
+	case JSON::ndString:
+		sz += v->getStringUtf8().length();
+		break;
+	case JSON::ndArray:
+	case JSON::ndObject:
+		for (JSON::ConstIterator iter = v->getFwConstIter(); iter.hasItems();) {
+			const JSON::ConstKeyValue &kv = iter.getNext();
+			sz += kv.getStringKey().length() + estimateSize(kv);
+		}
+		break;
+	default:
+		break;
+	}
+	return sz;
+}
+
 
 QueryCache::CachedItem QueryCache::find(ConstStrA url) {
 
@@ -20,6 +47,7 @@ QueryCache::CachedItem QueryCache::find(ConstStrA url) {
 
 	const CachedItem *itm = itemMap.find(StrKey(url));
 	if (itm) {
+		const_cast<CachedItem *>(itm)->lastAccess = getTime();
 		return *itm;
 	} else {
 		return CachedItem();
@@ -28,31 +56,290 @@ QueryCache::CachedItem QueryCache::find(ConstStrA url) {
 }
 
 void QueryCache::clear() {
+	Synchronized<FastLock> _(lock);
+	for (ItemMap::Iterator iter = itemMap.getFwIter(); iter.hasItems();) {
+		removeItem(iter.getNext().value);
+	}
 	itemMap.clear();
 }
 
 void QueryCache::set(ConstStrA url, const CachedItem& item) {
+	set(url, item, categorize(url));
+}
+
+void QueryCache::set(ConstStrA url, const CachedItem& item, Category cat) {
+	CachedItem stored(item.etag, item.seqNum, item.value);
+	stored.size = item.size?item.size:estimateSize(item.value);
+	stored.notFound = item.notFound;
+	stored.priority = item.priority;
+	stored.storedTime = stored.lastAccess = getTime();
+
 	Synchronized<FastLock> _(lock);
 	StrKey k((StringA(url)));
-	itemMap.erase(k);
-	itemMap.insert(k, item);
+	const CachedItem *prev = itemMap.find(k);
+	if (prev) {
+		removeItem(*prev);
+		itemMap.erase(k);
+	}
+	itemMap.insert(k, stored);
+	lockInc(stats.items);
+	lockExchangeAdd(stats.bytesHeld, stored.size);
+	lockInc(stats.categories[cat].sets);
+	if (natural(stats.bytesHeld) > sizeLimit) enforceLimit();
+}
+
+void QueryCache::touch(ConstStrA url) {
+	Synchronized<FastLock> _(lock);
+	CachedItem *itm = itemMap.find(StrKey(url));
+	if (itm) itm->storedTime = itm->lastAccess = getTime();
+}
+
+void QueryCache::setLimit(natural maxBytes) {
+	Synchronized<FastLock> _(lock);
+	sizeLimit = maxBytes;
+	if (natural(stats.bytesHeld) > sizeLimit) enforceLimit();
+}
+
+natural QueryCache::getTime() {
+	using namespace std::chrono;
+	return natural(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+struct QueryCache::EvictCandidate {
+	StrKey key;
+	natural priority;
+	natural lastAccess;
+	natural size;
+
+	EvictCandidate() {}
+	EvictCandidate(const StrKey &key, const CachedItem &itm)
+		:key(key),priority(itm.priority),lastAccess(itm.lastAccess),size(itm.size) {}
+};
+
+struct EvictCandidateCmp {
+	template<typename T>
+	bool operator()(const T &a, const T &b) const {
+		//lowest priority first, then the least recently used
+		if (a.priority != b.priority) return a.priority < b.priority;
+		return a.lastAccess < b.lastAccess;
+	}
+};
+
+void QueryCache::enforceLimit() {
+	//must be called under lock
+	natural target = sizeLimit / 10 * 9;
+	AutoArray<EvictCandidate> candidates;
+	candidates.reserve(itemMap.length());
+	HeapSort<AutoArray<EvictCandidate>, EvictCandidateCmp> heapSort(candidates, EvictCandidateCmp());
+	for (ItemMap::Iterator iter = itemMap.getFwIter(); iter.hasItems();) {
+		const ItemMap::KeyValue &kv = iter.getNext();
+		candidates.add(EvictCandidate(kv.key, kv.value));
+		heapSort.push();
+	}
+	heapSort.sortHeap();
+
+	for (natural i = 0; i < candidates.length() && natural(stats.bytesHeld) > target; i++) {
+		const CachedItem *itm = itemMap.find(candidates[i].key);
+		removeItem(*itm);
+		itemMap.erase(candidates[i].key);
+	}
+}
+
+void QueryCache::removeItem(const CachedItem &item) {
+	lockDec(stats.items);
+	lockExchangeAdd(stats.bytesHeld, -atomicValue(item.size));
+	lockInc(stats.evictions);
+}
+
+QueryCache::QueryCache():accessLogEnabled(false),negativeCaching(false),sizeLimit(naturalNull),accessLogLimit(10000) {
+}
+
+void QueryCache::enableNegativeCaching(bool enable) {
+	negativeCaching = enable;
 }
 
 QueryCache::~QueryCache() {
 	clear();
 }
 
-atomicValue& QueryCache::trackSeqNumbers(ConstStrA databaseName) {
+QueryCache::SeqRecord &QueryCache::getSeqRecord(ConstStrA databaseName) {
 	Synchronized<FastLock> _(lock);
-	atomicValue *p = seqMap.find(StrKey(databaseName));
+	SeqRecord *p = seqMap.find(StrKey(databaseName));
 	if (p) {
 		return *p;
 	} else {
-		seqMap.insert(StrKey((StringA(databaseName))),0);
+		seqMap.insert(StrKey((StringA(databaseName))),SeqRecord());
 		return *seqMap.find(StrKey(databaseName));
 	}
 }
 
+atomicValue& QueryCache::trackSeqNumbers(ConstStrA databaseName) {
+	return getSeqRecord(databaseName).seqNum;
+}
+
+atomic &QueryCache::getSeqInvalidations(ConstStrA databaseName) {
+	return getSeqRecord(databaseName).invalidations;
+}
 
-} /* namespace LightCouch */
+QueryCache::Category QueryCache::categorize(ConstStrA url) {
+	if (url.find(ConstStrA("/_view/")) != naturalNull
+			|| url.find(ConstStrA("/_list/")) != naturalNull) return catView;
+	if (url.find(ConstStrA("/_show/")) != naturalNull) return catShow;
+	if (url.head(1) == ConstStrA('_')
+			&& url.head(8) != ConstStrA("_design/")
+			&& url.head(7) != ConstStrA("_local/")) return catOther;
+	return catDocument;
+}
+
+void QueryCache::reportHit(ConstStrA url) {
+	lockInc(stats.categories[categorize(url)].hits);
+}
+
+void QueryCache::reportRevalidation(ConstStrA url) {
+	lockInc(stats.categories[categorize(url)].revalidations);
+}
+
+void QueryCache::reportMiss(ConstStrA url) {
+	lockInc(stats.categories[categorize(url)].misses);
+}
+
+void QueryCache::resetStats() {
+	for (natural i = 0; i < catCount; i++) {
+		Counters &c = stats.categories[i];
+		c.hits = c.revalidations = c.misses = c.sets = 0;
+	}
+	stats.evictions = 0;
+	Synchronized<FastLock> _(lock);
+	for (SeqMap::Iterator iter = seqMap.getFwIter(); iter.hasItems();) {
+		const SeqMap::KeyValue &kv = iter.getNext();
+		const_cast<SeqRecord &>(kv.value).invalidations = 0;
+	}
+}
+
+static const char *categoryNames[] = {"views","shows","documents","other"};
+
+ConstValue QueryCache::dumpStats(const Json &json) const {
+	Container cats = json.object();
+	for (natural i = 0; i < catCount; i++) {
+		const Counters &c = stats.categories[i];
+		cats.set(categoryNames[i], json("hits",natural(c.hits))
+									 ("revalidations",natural(c.revalidations))
+									 ("misses",natural(c.misses))
+									 ("sets",natural(c.sets)));
+	}
+	Container dbs = json.object();
+	{
+		Synchronized<FastLock> _(lock);
+		for (SeqMap::Iterator iter = seqMap.getFwIter(); iter.hasItems();) {
+			const SeqMap::KeyValue &kv = iter.getNext();
+			dbs.set(kv.key, json("seq",natural(kv.value.seqNum))
+					("seqInvalidations",natural(kv.value.invalidations)));
+		}
+	}
+	return json("items",natural(stats.items))
+			("bytes",natural(stats.bytesHeld))
+			("evictions",natural(stats.evictions))
+			("categories",cats)
+			("databases",dbs);
+}
+
+
+void QueryCache::enableAccessLog(bool enable) {
+	accessLogEnabled = enable;
+}
+
+void QueryCache::setAccessLogLimit(natural maxPaths) {
+	Synchronized<FastLock> _(lock);
+	accessLogLimit = maxPaths?maxPaths:1;
+	if (accessMap.length() > accessLogLimit) pruneAccessLog();
+}
 
+void QueryCache::recordAccess(ConstStrA database, ConstStrA url) {
+	if (!accessLogEnabled) return;
+	StringA key = database + ConstStrA(':') + url;
+	Synchronized<FastLock> _(lock);
+	AccessRecord *rec = accessMap.find(StrKey(key));
+	if (rec == 0) {
+		if (accessMap.length() >= accessLogLimit) pruneAccessLog();
+		accessMap.insert(StrKey(key), AccessRecord(database,url));
+		rec = accessMap.find(StrKey(key));
+	}
+	rec->count++;
+}
+
+struct AccessRecordCmp {
+	template<typename T>
+	bool operator()(const T &a, const T &b) const {
+		//most frequently used first
+		return a.count > b.count;
+	}
+};
+
+void QueryCache::pruneAccessLog() {
+	//keep the most frequently accessed half, lock must be held by the caller
+	AutoArray<AccessRecord> records;
+	records.reserve(accessMap.length());
+	HeapSort<AutoArray<AccessRecord>, AccessRecordCmp> heapSort(records, AccessRecordCmp());
+	for (AccessMap::Iterator iter = accessMap.getFwIter(); iter.hasItems();) {
+		records.add(iter.getNext().value);
+		heapSort.push();
+	}
+	heapSort.sortHeap();
+
+	accessMap.clear();
+	natural keep = accessLogLimit / 2;
+	for (natural i = 0, cnt = records.length(); i < cnt && i < keep; i++) {
+		const AccessRecord &rec = records[i];
+		accessMap.insert(StrKey(StringA(rec.database + ConstStrA(':') + rec.url)), rec);
+	}
+}
+
+void QueryCache::saveAccessLog(ConstStrW fileName, natural maxItems) const {
+	AutoArray<AccessRecord> records;
+	{
+		Synchronized<FastLock> _(lock);
+		records.reserve(accessMap.length());
+		HeapSort<AutoArray<AccessRecord>, AccessRecordCmp> heapSort(records, AccessRecordCmp());
+		for (AccessMap::Iterator iter = accessMap.getFwIter(); iter.hasItems();) {
+			records.add(iter.getNext().value);
+			heapSort.push();
+		}
+		heapSort.sortHeap();
+	}
+
+	Json json(JSON::create());
+	Container out = json.array();
+	for (natural i = 0, cnt = records.length(); i < cnt && i < maxItems; i++) {
+		const AccessRecord &rec = records[i];
+		out.add(json("db",rec.database)("path",rec.url)("count",rec.count));
+	}
+
+	SeqFileOutput outfile(fileName, OpenFlags::create|OpenFlags::truncate);
+	SeqTextOutA textout(outfile);
+	JSON::serialize(out,textout,true);
+}
+
+natural QueryCache::warmUp(CouchDBPool &pool, ConstStrW fileName, natural maxParallel) {
+	JSON::PFactory factory = JSON::create();
+	SeqFileInput infile(fileName, 0);
+	ConstValue log = factory->fromStream(infile);
+
+	atomic loaded = 0;
+	pool.parallel(log.length(), maxParallel, [&](CouchDB &db, natural index) {
+		ConstValue rec = log[index];
+		StringA prevDb = db.getCurrentDB();
+		try {
+			db.use(rec["db"].getStringA());
+			//use() resets the tracking, without seq. numbers the items could be validated by ETag only
+			db.trackSeqNumbers();
+			db.requestGET(rec["path"].getStringA(), null, CouchDB::flgRefreshCache);
+			lockInc(loaded);
+		} catch (const Exception &) {
+			//paths which cannot be loaded are skipped
+		}
+		db.use(prevDb);
+	});
+	return loaded;
+}
+
+} /* namespace LightCouch */
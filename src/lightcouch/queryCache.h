@@ -14,12 +14,16 @@
 #include <lightspeed/utils/json/json.h>
 #include "lightspeed/base/containers/stringKey.h"
 #include "lightspeed/base/containers/map.h"
+#include "lightspeed/mt/atomic.h"
+#include "lightspeed/mt/fastlock.h"
 
 #include "object.h"
 namespace LightCouch {
 
 using namespace LightSpeed;
 
+class CouchDBPool;
+
 ///Query cache stores results of various queries to the CouchDB
 /**
  * Query cache can store just GET query only,when JSON is result. It cannot store
@@ -37,8 +41,18 @@ public:
 		const StringA etag;
 		atomicValue seqNum;
 		const ConstValue value;
+		///estimated count of bytes occupied by the value (calculated by the function set())
+		natural size;
+		///the item represents cached "not found" response. The value contains error information
+		bool notFound;
+		///time when the item has been stored (in milliseconds, see getTime())
+		natural storedTime;
+		///time of the last access (in milliseconds, see getTime())
+		natural lastAccess;
+		///priority of the item. Items with lower priority are evicted first (see View::CachePolicy::Priority)
+		natural priority;
 
-		CachedItem() {}
+		CachedItem():size(0),notFound(false),storedTime(0),lastAccess(0),priority(1) {}
 		///Create cached item
 		/**
 		 *
@@ -47,8 +61,66 @@ public:
 		 * @param value value to store
 		 */
 		CachedItem(StringA etag, natural seqNum, ConstValue value)
-			:etag(etag),seqNum(seqNum), value(value) {}
+			:etag(etag),seqNum(seqNum), value(value),size(0),notFound(false)
+			 ,storedTime(0),lastAccess(0),priority(1) {}
 		bool isDefined() const {return value != null;}
+
+		///Create cached "not found" response
+		/**
+		 * @param seqNum seq. number known when the response has been received
+		 * @param errorInfo error information returned by the server
+		 * @return cached item
+		 */
+		static CachedItem notFoundItem(natural seqNum, ConstValue errorInfo) {
+			CachedItem itm(StringA(), seqNum, errorInfo);
+			itm.notFound = true;
+			return itm;
+		}
+	};
+
+	///Category of the cached path. Statistics are collected for each category separately
+	enum Category {
+		///result of a view or a list (path contains _view or _list)
+		catView,
+		///result of a show handler (path contains _show)
+		catShow,
+		///single document, including the design and local documents
+		catDocument,
+		///anything else, for example _all_docs
+		catOther,
+
+		catCount
+	};
+
+	///Counters collected for single category
+	struct Counters {
+		///count of requests served directly from the cache without contacting the server
+		atomic hits;
+		///count of requests revalidated by the server (status 304)
+		atomic revalidations;
+		///count of requests which had to be downloaded (item was missing or out of date)
+		atomic misses;
+		///count of items stored to the cache
+		atomic sets;
+
+		Counters():hits(0),revalidations(0),misses(0),sets(0) {}
+	};
+
+	///Statistics of the cache
+	/** All counters are updated using atomic operations, so reading them doesn't need any lock. Note
+	 * that values are not read atomically as whole, so the snapshot can be slightly inconsistent
+	 */
+	struct Stats {
+		///counters for each category (see Category)
+		Counters categories[catCount];
+		///count of items removed from the cache (replaced or cleared)
+		atomic evictions;
+		///count of items currently held in the cache
+		atomic items;
+		///estimated count of bytes currently held in the cache
+		atomic bytesHeld;
+
+		Stats():evictions(0),items(0),bytesHeld(0) {}
 	};
 
 	///search for url in the cache
@@ -57,9 +129,62 @@ public:
 	///set content to cache (override if exists)
 	void set(ConstStrA url, const CachedItem &item);
 
+	///set content to cache (override if exists)
+	/**
+	 * @param key key of the item
+	 * @param item item to store
+	 * @param cat category used for the statistics. Use this variant, when the key is not
+	 * the relative path (for example it is prefixed by the database name)
+	 */
+	void set(ConstStrA key, const CachedItem &item, Category cat);
+
+	///Marks the item as fresh
+	/** Function is called when the server confirms, that the cached item is still valid
+	 * (status 304). It resets the time when the item has been stored, so the item
+	 * can be served without revalidation until its TTL expires again
+	 *
+	 * @param url key of the item
+	 */
+	void touch(ConstStrA url);
+
 	///clear the cache
 	void clear();
 
+	///Sets the limit of the memory held by the cache
+	/**
+	 * Once the estimated size of all items exceeds the limit, the cache evicts items
+	 * until the size drops below 90% of the limit. Items with the lowest priority are evicted
+	 * first, items with the same priority are evicted starting by the least recently used one.
+	 *
+	 * @param maxBytes maximum estimated count of bytes. Default value is naturalNull, which means no limit
+	 */
+	void setLimit(natural maxBytes);
+
+	///Estimates count of bytes occupied by the JSON value
+	/** The estimation is not exact, it counts length of strings and keys and
+	 * adds constant overhead for every node.
+	 */
+	static natural estimateSize(const ConstValue &v);
+
+	///Retrieves current time in milliseconds. The time is monotonic, it is used to calculate age of items
+	static natural getTime();
+
+	///Enables caching of "not found" responses (negative caching)
+	/**
+	 * When enabled, the response with status 404 is stored to the cache. Next request to
+	 * the same path throws the RequestError directly from the cache without contacting the server.
+	 *
+	 * Because the "not found" response has no ETag, it can be validated by the sequence number only. So
+	 * the negative caching is in effect only for connections, which track sequence numbers
+	 * (see CouchDB::trackSeqNumbers()). Any change in the database invalidates all negative items
+	 *
+	 * @param enable true to enable, false to disable. Default is disabled
+	 */
+	void enableNegativeCaching(bool enable);
+
+	///Determines whether negative caching is enabled
+	bool isNegativeCachingEnabled() const {return negativeCaching;}
+
 
 	///Starts tracking sequence numbers
 	/** Creates a record for sequence numbers for specified database.
@@ -69,7 +194,110 @@ public:
 	 */
 	atomicValue &trackSeqNumbers(ConstStrA databaseName);
 
+	///Retrieves counter of seq-number invalidations for specified database
+	/** The counter is incremented everytime the cached item cannot be returned
+	 * directly, because the sequence number has been changed since the item was stored.
+	 *
+	 * @param databaseName name of database
+	 * @return reference to the counter.
+	 */
+	atomic &getSeqInvalidations(ConstStrA databaseName);
 
+	///Determines category of the path
+	static Category categorize(ConstStrA url);
+
+	///Records the request served from the cache
+	void reportHit(ConstStrA url);
+	///Records the request revalidated by the server
+	void reportRevalidation(ConstStrA url);
+	///Records the request which had to be downloaded
+	void reportMiss(ConstStrA url);
+
+	///Retrieves statistics
+	const Stats &getStats() const {return stats;}
+
+	///Resets all counters (except items and bytesHeld which reflect current state)
+	void resetStats();
+
+	///Dumps statistics as JSON
+	/**
+	 * @param json json builder
+	 * @return JSON object with the statistics. Example:
+	 *
+	 * @code
+	 * {
+	 *   "items":120,
+	 *   "bytes":458213,
+	 *   "evictions":12,
+	 *   "categories":{
+	 *        "views":{"hits":100,"revalidations":20,"misses":15,"sets":15},
+	 *        "shows":{...},
+	 *        "documents":{...},
+	 *        "other":{...}
+	 *   },
+	 *   "databases":{
+	 *        "dbname":{"seq":"...","seqInvalidations":5}
+	 *   }
+	 * }
+	 * @endcode
+	 *
+	 */
+	ConstValue dumpStats(const Json &json) const;
+
+
+	///Enables or disables recording of the accessed paths
+	/**
+	 * When recording is enabled, the cache counts accesses to every cacheable path. The
+	 * hot paths can be saved by the function saveAccessLog() and replayed during the
+	 * next start by the function warmUp()
+	 *
+	 * @param enable true to enable recording, false to disable recording. Disabling
+	 * recording doesn't clear already recorded data
+	 */
+	void enableAccessLog(bool enable);
+
+	///Sets maximum count of paths held by the access log
+	/**
+	 * @param maxPaths maximum count of recorded paths. Once the limit is reached, the
+	 * less frequently accessed half of the paths is discarded, so the memory used by
+	 * the log stays bounded while the hot paths are kept. Default value is 10000
+	 */
+	void setAccessLogLimit(natural maxPaths);
+
+	///Records access to the path
+	/** Function is called by the CouchDB object. It does nothing, if the recording is disabled
+	 *
+	 * @param database name of database
+	 * @param url relative path to the database
+	 */
+	void recordAccess(ConstStrA database, ConstStrA url);
+
+	///Saves most frequently accessed paths to the file
+	/**
+	 * @param fileName name of the file
+	 * @param maxItems maximum count of paths to store. The paths are ordered by count of
+	 * accesses, so the most frequently used paths are stored.
+	 *
+	 * The file is stored as JSON array, where each item contains database name, path and count of accesses
+	 */
+	void saveAccessLog(ConstStrW fileName, natural maxItems = naturalNull) const;
+
+	///Loads content of the cache using the access log stored by the function saveAccessLog()
+	/**
+	 * Function downloads all paths stored in the log in parallel and stores results to the cache. You
+	 * should call this function during startup before the service is reported as ready.
+	 *
+	 * @param pool pool of connections. The connections must use this cache (see Config::cache).
+	 * @param fileName name of the file created by saveAccessLog()
+	 * @param maxParallel maximum count of requests processed in parallel
+	 * @return count of successfully loaded paths. Paths which cannot be loaded are skipped
+	 *
+	 * @exception FileIOException the file cannot be opened
+	 */
+	natural warmUp(CouchDBPool &pool, ConstStrW fileName, natural maxParallel = 4);
+
+
+	QueryCache();
 	~QueryCache();
 
 
@@ -77,14 +305,43 @@ protected:
 
 	typedef StringKey<StringA> StrKey;
 
+	struct SeqRecord {
+		atomicValue seqNum;
+		atomic invalidations;
+
+		SeqRecord():seqNum(0),invalidations(0) {}
+	};
+
+	struct AccessRecord {
+		StringA database;
+		StringA url;
+		natural count;
+
+		AccessRecord() {}
+		AccessRecord(StringA database, StringA url):database(database),url(url),count(0) {}
+	};
 
 	typedef Map<StrKey, CachedItem  > ItemMap;
-	typedef Map<StrKey, atomicValue> SeqMap;
+	typedef Map<StrKey, SeqRecord> SeqMap;
+	typedef Map<StrKey, AccessRecord> AccessMap;
 
 	ItemMap itemMap;
 	SeqMap seqMap;
+	AccessMap accessMap;
+	Stats stats;
+	bool accessLogEnabled;
+	bool negativeCaching;
+	natural sizeLimit;
+	natural accessLogLimit;
+
+	mutable FastLock lock;
+
+	SeqRecord &getSeqRecord(ConstStrA databaseName);
+	void removeItem(const CachedItem &item);
+	void enforceLimit();
+	void pruneAccessLog();
 
-	FastLock lock;
+	struct EvictCandidate;
 };
 
 } /* namespace LightCouch */
@@ -0,0 +1,82 @@
+/*
+ * queryProfile.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_QUERYPROFILE_H_
+#define LIGHTCOUCH_QUERYPROFILE_H_
+
+#include <chrono>
+#include <lightspeed/base/types.h>
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Timing breakdown of the query (see Query::execProfiled())
+/**
+ * All times are in microseconds. Values are accumulated, so the query which sends
+ * multiple requests (see Query::splitKeys()) reports the sum of all requests. Chunks
+ * executed in parallel through the pool are not broken down, they are counted in the total only.
+ *
+ * Profile is connected with the CouchDB instance for duration of the query (see CouchDB::ProfileScope).
+ * While the profile is active, the body of the response is read into the memory before
+ * it is parsed, so the transfer and the parsing can be measured separately.
+ */
+struct QueryProfile {
+	///building the URL of the request
+	natural urlBuild;
+	///looking up the result in the QueryCache
+	natural cacheLookup;
+	///waiting to the connection, which can be used by other thread
+	natural connectionWait;
+	///sending the request and waiting for the header of the response. This includes
+	///the time to open the connection and the time spent by the server to process the view
+	natural firstByte;
+	///receiving the body of the response
+	natural transfer;
+	///parsing the JSON
+	natural parse;
+	///postprocessing function of the view
+	natural postprocess;
+	///construction of the Result object
+	natural resultBuild;
+	///total time of the query
+	natural total;
+	///count of received bytes of the body
+	natural bytes;
+	///count of requests sent to the server
+	natural requests;
+	///count of results returned from the QueryCache (including revalidated results)
+	natural cacheHits;
+
+	QueryProfile() {clear();}
+
+	///Resets all counters
+	void clear() {
+		urlBuild = cacheLookup = connectionWait = firstByte = transfer = parse = 0;
+		postprocess = resultBuild = total = bytes = requests = cacheHits = 0;
+	}
+
+	///Measures time between laps
+	class Stopwatch {
+	public:
+		Stopwatch():start(Clock::now()) {}
+		///Returns time since the previous lap (or construction) in microseconds and starts next lap
+		natural lap() {
+			Clock::time_point now = Clock::now();
+			natural r = natural(std::chrono::duration_cast<std::chrono::microseconds>(now - start).count());
+			start = now;
+			return r;
+		}
+	protected:
+		typedef std::chrono::steady_clock Clock;
+		Clock::time_point start;
+	};
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_QUERYPROFILE_H_ */
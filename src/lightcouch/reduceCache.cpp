@@ -0,0 +1,121 @@
+/*
+ * reduceCache.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "reduceCache.h"
+
+#include "lightspeed/base/containers/autoArray.tcc"
+#include "lightspeed/base/containers/map.tcc"
+#include "lightspeed/base/sync/synchronize.h"
+#include "lightspeed/base/text/toString.tcc"
+
+#include "couchDB.h"
+#include "query.h"
+
+namespace LightCouch {
+
+ReduceCache::ReduceCache(natural fineLevel, natural maxResults)
+	:fineLevel(fineLevel),maxResults(maxResults?maxResults:1),accessCounter(0) {
+}
+
+StringA ReduceCache::currentSeq(CouchDB& db) {
+	atomicValue tracked = db.getTrackedSeqNumber();
+	if (tracked) return StringA(ConstStrA(ToString<natural>(natural(tracked))));
+	ConstValue seq = db.getLastSeqNumber();
+	if (seq == null) return StringA();
+	if (seq->isString()) return seq.getStringA();
+	return StringA(db.json.factory->toString(*seq));
+}
+
+Result ReduceCache::exec(const Query& q) {
+	q.finishCurrent();
+	const View &view = q.viewDefinition;
+	natural level = q.groupLevel;
+	if (!view.rereduce || level == naturalNull || level > fineLevel
+			|| (q.keys != nil && q.keys->length() > 1)
+			|| q.offset != 0 || q.maxlimit != naturalNull || !q.offset_doc.empty()
+			|| !q.projection.empty()) {
+		return q.exec();
+	}
+
+	CouchDB &db = q.db;
+	Query fq(q);
+	fq.group(fineLevel);
+	fq.buildRequest(fq.json, fq.urlline, fq.keys);
+	StrKey key(StringA(db.getCurrentDB() + ConstStrA(':') + ConstStrA(fq.urlline.getArray())));
+	StringA seq = currentSeq(db);
+
+	ConstValue fine;
+	{
+		Synchronized<FastLock> _(lock);
+		Entry *e = resultMap.find(key);
+		if (e && e->seq == seq) {
+			fine = e->result;
+			e->lastAccess = ++accessCounter;
+		}
+	}
+	if (fine == null) {
+		fine = fq.execRequest(db, fq.json, fq.urlline, fq.keys);
+		Synchronized<FastLock> _(lock);
+		resultMap.erase(key);
+		while (resultMap.length() >= maxResults) evictOldest();
+		resultMap.insert(key, Entry(seq, fine, ++accessCounter));
+	}
+
+	ConstValue result = level == fineLevel?fine:regroup(q.json, fine, level, view.rereduce);
+	if (view.postprocess) {
+		result = view.postprocess(&db, q.args, result);
+	}
+	return Result(q.json, result);
+}
+
+ConstValue ReduceCache::regroup(const Json& json, const ConstValue& fine, natural level, const View::Rereduce& rereduce) {
+	AutoArray<ConstValue> values;
+	Result res(json, fine);
+	return res.groupSorted(level, [&](const ConstStringT<ConstValue> &rows) -> ConstValue {
+		values.clear();
+		for (natural i = 0; i < rows.length(); i++) values.add(rows[i]["value"]);
+		//key of the group is the prefix of the key, level 0 has no key
+		ConstValue k = rows[0]["key"];
+		if (level == 0) {
+			k = json(null);
+		} else if (k != null && k->getType() == JSON::ndArray && k->length() > level) {
+			Container prefix = json.array();
+			for (natural i = 0; i < level; i++) prefix.add(k[i]);
+			k = prefix;
+		}
+		return json("key",k)("value",rereduce(json, ConstStringT<ConstValue>(values)));
+	});
+}
+
+void ReduceCache::evictOldest() {
+	//lock must be held by the caller. The count of results is small, so linear search is enough
+	const StrKey *oldest = 0;
+	natural oldestAccess = naturalNull;
+	for (ResultMap::Iterator iter = resultMap.getFwIter(); iter.hasItems();) {
+		const ResultMap::KeyValue &kv = iter.getNext();
+		if (kv.value.lastAccess < oldestAccess) {
+			oldestAccess = kv.value.lastAccess;
+			oldest = &kv.key;
+		}
+	}
+	if (oldest) {
+		StrKey k(*oldest);
+		resultMap.erase(k);
+	}
+}
+
+void ReduceCache::clear() {
+	Synchronized<FastLock> _(lock);
+	resultMap.clear();
+}
+
+natural ReduceCache::size() const {
+	Synchronized<FastLock> _(lock);
+	return resultMap.length();
+}
+
+} /* namespace LightCouch */
@@ -0,0 +1,112 @@
+/*
+ * reduceCache.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_REDUCECACHE_H_
+#define LIGHTCOUCH_REDUCECACHE_H_
+
+#include <lightspeed/base/containers/string.h>
+#include "lightspeed/base/containers/stringKey.h"
+#include "lightspeed/base/containers/map.h"
+#include "lightspeed/mt/fastlock.h"
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+#include "view.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class CouchDB;
+class Query;
+class Result;
+
+///Calculates coarser group levels of the reduced view on the client side
+/**
+ * The view is requested once at the fine group level. The result is stored in the cache and
+ * the coarser group levels are calculated from it by the rereduce function registered to the
+ * view (see View::setRereduce()). Because the rows are ordered by the key, the groups are
+ * detected without sorting.
+ *
+ * The cached result is valid until the sequence number of the database changes. If the
+ * connection tracks the sequence numbers (see CouchDB::trackSeqNumbers()), the cached
+ * result is returned without contacting the server. Otherwise the last sequence number is
+ * requested from the server, which is much cheaper than the query itself.
+ *
+ * @code
+ * View sales("_design/sales/_view/by_date", View::reduce, ...);
+ * ReduceCache cache(3);
+ * Query q(db.createQuery(sales.setRereduce(&View::rereduceSum)));
+ * q.group(1);
+ * Result years = cache.exec(q);  //requests group_level=3
+ * q.reset();
+ * q.group(2);
+ * Result months = cache.exec(q); //no view request
+ * @endcode
+ *
+ * Cache is MT safe, it can be shared between many connections.
+ */
+class ReduceCache {
+public:
+
+	///Construct the cache
+	/**
+	 * @param fineLevel group level requested from the server. Queries with the
+	 * level up to this value are calculated from the cached result
+	 * @param maxResults maximum count of cached results. When the limit is reached, the
+	 * least recently used result is removed
+	 */
+	ReduceCache(natural fineLevel, natural maxResults = 100);
+
+	///Executes the query
+	/**
+	 * @param q query. If the view has no rereduce function, the query doesn't reduce,
+	 * the group level is above the fine level, the query selects multiple keys, or
+	 * it has the limit or the offset, the query is executed directly
+	 * @return result
+	 */
+	Result exec(const Query &q);
+
+	///Clears the cache
+	void clear();
+
+	///Retrieves count of cached results
+	natural size() const;
+
+protected:
+
+	struct Entry {
+		///sequence number of the database when the result has been requested
+		StringA seq;
+		///result at the fine group level
+		ConstValue result;
+		///value of the access counter at the last access
+		natural lastAccess;
+
+		Entry():lastAccess(0) {}
+		Entry(StringA seq, ConstValue result, natural lastAccess)
+			:seq(seq),result(result),lastAccess(lastAccess) {}
+	};
+
+	typedef StringKey<StringA> StrKey;
+	typedef Map<StrKey, Entry> ResultMap;
+
+	natural fineLevel;
+	natural maxResults;
+	natural accessCounter;
+	ResultMap resultMap;
+	mutable FastLock lock;
+
+	void evictOldest();
+
+	static StringA currentSeq(CouchDB &db);
+	static ConstValue regroup(const Json &json, const ConstValue &fine, natural level, const View::Rereduce &rereduce);
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_REDUCECACHE_H_ */
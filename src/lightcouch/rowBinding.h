@@ -0,0 +1,229 @@
+/*
+ * rowBinding.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_ROWBINDING_H_
+#define LIGHTCOUCH_ROWBINDING_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <lightspeed/base/containers/autoArray.h>
+#include <lightspeed/base/streams/fileio.h>
+
+#include "jsonPull.h"
+#include "query.h"
+#include "couchDB.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Describes how the fields of the result rows are stored into members of a C++ object
+/**
+ * Binding maps paths in the row to members of the object. The path is a dot separated list of
+ * the names of the fields, the numbers are used as indexes of the arrays. For example "id",
+ * "key.0", "value.name" or "doc.address.city".
+ *
+ * The rows are decoded while the response is parsed. Only bound fields are converted,
+ * all other parts of the row are skipped without building a JSON tree.
+ *
+ * @code
+ * struct Person {
+ *    StringA name;
+ *    natural age;
+ * };
+ *
+ * RowBinding<Person> binding;
+ * binding.bind("key", &Person::name).bind("value.age", &Person::age);
+ * AutoArray<Person> persons = query.exec(binding);
+ * @endcode
+ *
+ * @tparam T type of the object. It must be default constructible and copyable
+ */
+template<typename T>
+class RowBinding {
+public:
+
+	typedef Query::RowParser Parser;
+	typedef typename Parser::Token Token;
+	///Function which decodes the value of the field into the object
+	/**
+	 * The function receives the object, the parser and the first token of the value. The function
+	 * must consume whole value (for example, by calling Parser::skipValue or Parser::parseValue)
+	 */
+	typedef std::function<void(T &, Parser &, Token)> FieldFn;
+
+	RowBinding():json(JSON::create()) {nodes.push_back(Node());}
+
+	///Binds string field
+	RowBinding &bind(ConstStrA path, StringA T::*member) {
+		return bind(path, FieldFn([member](T &t, Parser &p, Token tk) {
+			if (tk == Parser::tkString || tk == Parser::tkNumber) t.*member = p.getString();
+			else if (tk == Parser::tkTrue) t.*member = ConstStrA("true");
+			else if (tk == Parser::tkFalse) t.*member = ConstStrA("false");
+			else p.skipValue(tk);
+		}));
+	}
+	///Binds unsigned integer field
+	RowBinding &bind(ConstStrA path, natural T::*member) {
+		return bind(path, FieldFn([member](T &t, Parser &p, Token tk) {
+			if (tk == Parser::tkNumber) t.*member = natural(p.getInt());
+			else p.skipValue(tk);
+		}));
+	}
+	///Binds signed integer field
+	RowBinding &bind(ConstStrA path, integer T::*member) {
+		return bind(path, FieldFn([member](T &t, Parser &p, Token tk) {
+			if (tk == Parser::tkNumber) t.*member = p.getInt();
+			else p.skipValue(tk);
+		}));
+	}
+	///Binds floating point field
+	RowBinding &bind(ConstStrA path, double T::*member) {
+		return bind(path, FieldFn([member](T &t, Parser &p, Token tk) {
+			if (tk == Parser::tkNumber) t.*member = p.getNumber();
+			else p.skipValue(tk);
+		}));
+	}
+	///Binds boolean field
+	RowBinding &bind(ConstStrA path, bool T::*member) {
+		return bind(path, FieldFn([member](T &t, Parser &p, Token tk) {
+			if (tk == Parser::tkTrue || tk == Parser::tkFalse) t.*member = tk == Parser::tkTrue;
+			else p.skipValue(tk);
+		}));
+	}
+	///Binds field which is stored as JSON value
+	/** Only this subtree is built as JSON tree. */
+	RowBinding &bind(ConstStrA path, ConstValue T::*member) {
+		Json json = this->json;
+		return bind(path, FieldFn([member,json](T &t, Parser &p, Token tk) {
+			t.*member = p.parseValue(tk, json);
+		}));
+	}
+	///Binds field to custom decoding function
+	RowBinding &bind(ConstStrA path, const FieldFn &fn) {
+		nodes[addPath(path)].fn = fn;
+		return *this;
+	}
+
+	///Decodes value into the object
+	/**
+	 * @param p parser
+	 * @param t first token of the value (usually the row)
+	 * @param item object which receives bound fields
+	 */
+	void decode(Parser &p, Token t, T &item) const {
+		decodeNode(0, p, t, item);
+	}
+
+protected:
+
+	struct Child {
+		std::string name;
+		//index in the array, or naturalNull, if the name is not a number
+		natural index;
+		natural node;
+	};
+
+	struct Node {
+		std::vector<Child> children;
+		FieldFn fn;
+	};
+
+	std::vector<Node> nodes;
+	Json json;
+
+	natural addPath(ConstStrA path) {
+		natural cur = 0;
+		for (ConstStrA::SplitIterator iter = path.split('.'); iter.hasItems();) {
+			ConstStrA part = iter.getNext();
+			std::string name(part.data(), part.length());
+			natural next = naturalNull;
+			for (natural i = 0; i < nodes[cur].children.size(); i++) {
+				if (nodes[cur].children[i].name == name) {
+					next = nodes[cur].children[i].node;
+					break;
+				}
+			}
+			if (next == naturalNull) {
+				Child c;
+				c.name = name;
+				c.index = parseIndex(name);
+				c.node = next = nodes.size();
+				nodes.push_back(Node());
+				nodes[cur].children.push_back(c);
+			}
+			cur = next;
+		}
+		return cur;
+	}
+
+	static natural parseIndex(const std::string &name) {
+		if (name.empty()) return naturalNull;
+		natural v = 0;
+		for (std::string::const_iterator iter = name.begin(); iter != name.end(); ++iter) {
+			if (*iter < '0' || *iter > '9') return naturalNull;
+			v = v * 10 + (*iter - '0');
+		}
+		return v;
+	}
+
+	natural findChild(const Node &n, ConstStrA name) const {
+		for (natural i = 0; i < n.children.size(); i++) {
+			const std::string &cn = n.children[i].name;
+			if (ConstStrA(cn.data(), cn.length()) == name) return n.children[i].node;
+		}
+		return naturalNull;
+	}
+
+	natural findChild(const Node &n, natural index) const {
+		for (natural i = 0; i < n.children.size(); i++) {
+			if (n.children[i].index == index) return n.children[i].node;
+		}
+		return naturalNull;
+	}
+
+	void decodeNode(natural nodeIdx, Parser &p, Token t, T &item) const {
+		const Node &n = nodes[nodeIdx];
+		if (n.fn) {
+			n.fn(item, p, t);
+		} else if (n.children.empty()) {
+			p.skipValue(t);
+		} else if (t == Parser::tkBeginObject) {
+			for (Token k = p.next(); k != Parser::tkEndObject; k = p.next()) {
+				if (k != Parser::tkString) throw ErrorMessageException(THISLOCATION,"Expected key in JSON object");
+				natural child = findChild(n, p.getString());
+				Token v = p.next();
+				if (child == naturalNull) p.skipValue(v);
+				else decodeNode(child, p, v, item);
+			}
+		} else if (t == Parser::tkBeginArray) {
+			natural idx = 0;
+			for (Token v = p.next(); v != Parser::tkEndArray; v = p.next(), idx++) {
+				if (v == Parser::tkEof) throw ErrorMessageException(THISLOCATION,"Unexpected end of JSON");
+				natural child = findChild(n, idx);
+				if (child == naturalNull) p.skipValue(v);
+				else decodeNode(child, p, v, item);
+			}
+		}
+	}
+};
+
+template<typename T>
+AutoArray<T> Query::exec(const RowBinding<T> &binding) const {
+	AutoArray<T> out;
+	streamTokens(RowTokenFn([&](RowParser &p, RowParser::Token r) {
+		T item = T();
+		binding.decode(p, r, item);
+		out.add(item);
+	}));
+	return out;
+}
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_ROWBINDING_H_ */
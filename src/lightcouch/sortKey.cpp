@@ -0,0 +1,249 @@
+/*
+ * sortKey.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "sortKey.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include "lightspeed/mt/thread.h"
+#include <lightspeed/base/streams/utf.h>
+
+namespace LightCouch {
+
+//type tags are ordered by the collation. Zero is reserved as terminator
+enum SortKeyTag {
+	tagEnd = 0,
+	tagEscape = 1,
+	tagNull = 1,
+	tagFalse = 2,
+	tagTrue = 3,
+	tagNumber = 4,
+	tagString = 5,
+	tagArray = 6,
+	tagObject = 7
+};
+
+static void appendString(std::string &out, ConstStrA str) {
+	//UTF-8 compared bytewise is ordered by code points.
+	//Bytes 0 and 1 are escaped, so terminator (0) is lower than any content
+	for (ConstStrA::Iterator iter = str.getFwIter(); iter.hasItems();) {
+		char c = iter.getNext();
+		if (c == 0 || c == 1) {
+			out.push_back(char(tagEscape));
+			out.push_back(char(c + 1));
+		} else {
+			out.push_back(c);
+		}
+	}
+	out.push_back(char(tagEnd));
+}
+
+//weights of the collation levels. Values 0 and 1 are reserved for the terminator and the level separator
+enum CollationWeights {
+	levelSeparator = 1,
+	//secondary level - accents in the order of the UCA
+	accNone = 2,
+	accAcute,
+	accGrave,
+	accCircumflex,
+	accRing,
+	accDiaeresis,
+	accTilde,
+	accCedilla,
+	accStroke,
+	//tertiary level - lower case is ordered before upper case
+	caseLower = 2,
+	caseUpper = 3
+};
+
+///Primary weights of ASCII characters. Zero means ignorable character (controls)
+class AsciiWeights {
+public:
+	AsciiWeights() {
+		//variable characters and digits in the order of the UCA
+		static const char order[] = "\t\n\v\f\r _-,;:!?.'\"()[]{}@*/\\&#%`^+<=>|~$0123456789";
+		std::memset(weights, 0, sizeof(weights));
+		natural w = 1;
+		for (const char *c = order; *c; c++) weights[(unsigned char)*c] = w++;
+		//letters have the same primary weight regardless on the case
+		for (char c = 'a'; c <= 'z'; c++) {
+			weights[(unsigned char)c] = weights[(unsigned char)(c - 'a' + 'A')] = w++;
+		}
+	}
+
+	natural operator[](natural c) const {return weights[c];}
+
+protected:
+	natural weights[128];
+};
+
+static const AsciiWeights &getAsciiWeights() {
+	static AsciiWeights weights;
+	return weights;
+}
+
+//Latin-1 letters U+00C0-U+00FF decomposed to the base letter and the accent. Character '-'
+//marks the letters, which are not decomposed
+static const char latin1UpperBase[] = "AAAAAA-CEEEEIIII-NOOOOO-OUUUUY--";
+static const char latin1LowerBase[] = "aaaaaa-ceeeeiiii-nooooo-ouuuuy-y";
+static const unsigned char latin1Accent[] = {
+		accGrave, accAcute, accCircumflex, accTilde, accDiaeresis, accRing, accNone, accCedilla,
+		accGrave, accAcute, accCircumflex, accDiaeresis, accGrave, accAcute, accCircumflex, accDiaeresis,
+		accNone, accTilde, accGrave, accAcute, accCircumflex, accTilde, accDiaeresis, accNone,
+		accStroke, accGrave, accAcute, accCircumflex, accDiaeresis, accAcute, accNone, accDiaeresis
+};
+
+//primary weights of characters without own rule are ordered after the letters by code points
+static const natural otherPrimaryBase = 0x100;
+//added to the primary weight, so the first byte of the weight is never 0 or 1
+static const natural primaryOffset = 0x20000;
+
+static void appendCollatedString(std::string &out, ConstStrA str) {
+	//multilevel key: primary weights (letters, digits, punctuation), secondary weights (accents)
+	//and tertiary weights (case). Code points are appended as the last level, so the different
+	//strings never have the same key
+	const AsciiWeights &ascii = getAsciiWeights();
+	std::string secondary, tertiary;
+	Utf8ToWideReader<ConstStrA::Iterator> iter(str.getFwIter());
+	iter.enableSkipInvalidChars(true);
+	while (iter.hasItems()) {
+		natural cp = natural(iter.getNext());
+		natural primary;
+		unsigned char sec = accNone, ter = caseLower;
+		if (cp < 128) {
+			primary = ascii[cp];
+			if (cp >= 'A' && cp <= 'Z') ter = caseUpper;
+		} else if (cp >= 0xC0 && cp <= 0xFF
+				&& (cp < 0xE0?latin1UpperBase:latin1LowerBase)[cp & 0x1F] != '-') {
+			primary = ascii[(unsigned char)(cp < 0xE0?latin1UpperBase:latin1LowerBase)[cp & 0x1F]];
+			sec = latin1Accent[cp & 0x1F];
+			if (cp < 0xE0) ter = caseUpper;
+		} else {
+			primary = otherPrimaryBase + cp;
+		}
+		if (primary == 0) continue;
+		primary += primaryOffset;
+		out.push_back(char((primary >> 16) & 0xFF));
+		out.push_back(char((primary >> 8) & 0xFF));
+		out.push_back(char(primary & 0xFF));
+		secondary.push_back(char(sec));
+		tertiary.push_back(char(ter));
+	}
+	out.push_back(char(levelSeparator));
+	out.append(secondary);
+	out.push_back(char(levelSeparator));
+	out.append(tertiary);
+	out.push_back(char(levelSeparator));
+	appendString(out, str);
+}
+
+static void appendNumber(std::string &out, double d) {
+	//zero and negative zero are equal
+	if (d == 0) d = 0;
+	std::uint64_t bits;
+	std::memcpy(&bits, &d, sizeof(bits));
+	//negative numbers have inverted all bits, positive numbers have inverted sign bit
+	if (bits & (std::uint64_t(1) << 63)) bits = ~bits;
+	else bits |= std::uint64_t(1) << 63;
+	for (int i = 7; i >= 0; i--) {
+		out.push_back(char((bits >> (i * 8)) & 0xFF));
+	}
+}
+
+void appendSortKey(std::string &out, const ConstValue &v) {
+	switch (v->getType()) {
+	case JSON::ndNull:
+		out.push_back(char(tagNull));
+		break;
+	case JSON::ndBool:
+		out.push_back(char(v->getBool()?tagTrue:tagFalse));
+		break;
+	case JSON::ndFloat:
+	case JSON::ndInt:
+		out.push_back(char(tagNumber));
+		appendNumber(out, v->getFloat());
+		break;
+	case JSON::ndString:
+		out.push_back(char(tagString));
+		appendCollatedString(out, v->getStringUtf8());
+		break;
+	case JSON::ndArray:
+		out.push_back(char(tagArray));
+		for (JSON::ConstIterator iter = v->getFwConstIter(); iter.hasItems();) {
+			appendSortKey(out, iter.getNext());
+		}
+		out.push_back(char(tagEnd));
+		break;
+	case JSON::ndObject:
+		out.push_back(char(tagObject));
+		for (JSON::ConstIterator iter = v->getFwConstIter(); iter.hasItems();) {
+			const JSON::ConstKeyValue &kv = iter.getNext();
+			//every member starts with nonzero byte, so shorter object is lower
+			out.push_back(char(tagEscape + 1));
+			appendCollatedString(out, kv.getStringKey());
+			appendSortKey(out, kv);
+		}
+		out.push_back(char(tagEnd));
+		break;
+	default:
+		out.push_back(char(tagNull));
+		break;
+	}
+}
+
+std::string makeSortKey(const ConstValue &v) {
+	std::string out;
+	appendSortKey(out, v);
+	return out;
+}
+
+static bool sortKeyItemLess(const SortKeyItem &a, const SortKeyItem &b) {
+	return a.key < b.key;
+}
+
+static bool sortKeyItemGreater(const SortKeyItem &a, const SortKeyItem &b) {
+	return b.key < a.key;
+}
+
+void sortKeyItems(std::vector<SortKeyItem> &items, natural threads, bool descending) {
+	//reversed comparison keeps equal items in the original order
+	bool (*less)(const SortKeyItem &, const SortKeyItem &) =
+			descending?&sortKeyItemGreater:&sortKeyItemLess;
+	natural cnt = items.size();
+	if (threads < 2 || cnt < threads * 2) {
+		std::stable_sort(items.begin(), items.end(), less);
+		return;
+	}
+
+	//sort parts in parallel
+	natural part = (cnt + threads - 1) / threads;
+	std::unique_ptr<Thread[]> workers(new Thread[threads-1]);
+	for (natural i = 1; i < threads; i++) {
+		natural b = i * part;
+		natural e = std::min(cnt, b + part);
+		if (b >= e) continue;
+		workers[i-1].start(ThreadFunction::create([&items, b, e, less] {
+			std::stable_sort(items.begin() + b, items.begin() + e, less);
+		}));
+	}
+	std::stable_sort(items.begin(), items.begin() + std::min(cnt, part), less);
+	for (natural i = 1; i < threads; i++) {
+		if (i * part < cnt) workers[i-1].join();
+	}
+
+	//merge sorted parts
+	for (natural width = part; width < cnt; width *= 2) {
+		for (natural lo = 0; lo + width < cnt; lo += 2 * width) {
+			std::inplace_merge(items.begin() + lo, items.begin() + lo + width,
+					items.begin() + std::min(cnt, lo + 2 * width), less);
+		}
+	}
+}
+
+} /* namespace LightCouch */
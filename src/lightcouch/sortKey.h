@@ -0,0 +1,75 @@
+/*
+ * sortKey.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_SORTKEY_H_
+#define LIGHTCOUCH_SORTKEY_H_
+
+#include <string>
+#include <vector>
+#include <lightspeed/base/types.h>
+#include <lightspeed/utils/json/json.h>
+
+#include "object.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+///Appends binary sort key of the JSON value to the buffer
+/**
+ * Binary sort keys compared byte by byte (memcmp, std::string::compare) are ordered
+ * by CouchDB's view collation (null, false, true, numbers, strings, arrays, objects). Strings
+ * are ordered as by the ICU root collation used by the server: punctuation before digits before
+ * letters, letters case-insensitive at first ("a" < "B"), then accents are compared and the
+ * lower case is ordered before the upper case ("a" < "A" < "aa"). Accented letters are
+ * recognized in the Latin-1 range only, other characters are ordered after the letters
+ * by code points. Different strings never have the same key.
+ *
+ * @note In contrast to sort keys, the function compareJson() compares strings by code points
+ *
+ * The key is calculated once per value, so sorting doesn't need to decode UTF-8 and walk
+ * the JSON structure on every comparison.
+ *
+ * @param out buffer where the key is appended. Keys of multiple values can be concatenated, the
+ * result is ordered as if the values were put into an array
+ * @param v value
+ */
+void appendSortKey(std::string &out, const ConstValue &v);
+
+///Creates binary sort key of the JSON value
+/**
+ * @param v value
+ * @return binary sort key. See appendSortKey()
+ */
+std::string makeSortKey(const ConstValue &v);
+
+///Item sorted by the function sortKeyItems()
+struct SortKeyItem {
+	///binary sort key
+	std::string key;
+	///index of the original item
+	natural index;
+
+	SortKeyItem() {}
+	SortKeyItem(const std::string &key, natural index):key(key),index(index) {}
+};
+
+///Sorts items by their keys
+/**
+ * Function performs stable merge sort. Parts of the array are sorted in parallel, then
+ * they are merged.
+ *
+ * @param items items to sort
+ * @param threads count of threads. Value 0 or 1 sorts in the current thread
+ * @param descending set true to sort in descending order. Items with the same key
+ * keep their original order in both directions
+ */
+void sortKeyItems(std::vector<SortKeyItem> &items, natural threads, bool descending = false);
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_SORTKEY_H_ */
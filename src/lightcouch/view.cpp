@@ -7,6 +7,8 @@
 
 #include "view.h"
 
+#include "lightspeed/base/containers/autoArray.tcc"
+
 namespace LightCouch {
 
 View::View(StringA viewPath)
@@ -40,20 +42,129 @@ Filter::Filter(const View& view, bool allRevs)
 Filter::Filter(StringA filter):View(filter) {
 }
 
+View View::copyWith(StringA viewPath, natural flags, ConstStringT<ListArg> args) const {
+	View v(viewPath, flags, postprocess, args);
+	v.cachePolicy = cachePolicy;
+	v.rereduce = rereduce;
+	return v;
+}
+
 View View::addArg(ConstStringT<ListArg> args) const {
-	return View(viewPath, flags, StringCore<ListArg>(this->args + args));
+	return copyWith(viewPath, flags, StringCore<ListArg>(this->args + args));
 }
 
 View View::setArgs(ConstStringT<ListArg> args) const {
-	return View(viewPath, flags, args);
+	return copyWith(viewPath, flags, args);
 }
 
 View View::setFlags(natural flags) const {
-	return View(viewPath, flags, args);
+	return copyWith(viewPath, flags, args);
 }
 
 View View::setPath(StringA path) const {
-	return View(path, flags, args);
+	return copyWith(path, flags, args);
+}
+
+View View::setCachePolicy(const CachePolicy &policy) const {
+	View v(*this);
+	v.cachePolicy = policy;
+	return v;
+}
+
+View View::setRereduce(const Rereduce &fn) const {
+	View v(*this);
+	v.rereduce = fn;
+	return v;
+}
+
+static ConstValue sumNumbers(const Json &json, const ConstStringT<ConstValue> &values) {
+	integer isum = 0;
+	double fsum = 0;
+	bool isFloat = false;
+	for (natural i = 0; i < values.length(); i++) {
+		const ConstValue &v = values[i];
+		if (v == null) continue;
+		if (v->getType() == JSON::ndInt) isum += v->getInt();
+		else {
+			isFloat = true;
+			fsum += v->getFloat();
+		}
+	}
+	if (isFloat) return json(fsum + isum);
+	else return json(isum);
+}
+
+ConstValue View::rereduceSum(const Json &json, const ConstStringT<ConstValue> &values) {
+	natural arrLen = 0;
+	for (natural i = 0; i < values.length(); i++) {
+		if (values[i] != null && values[i]->getType() == JSON::ndArray && values[i]->length() > arrLen)
+			arrLen = values[i]->length();
+	}
+	if (arrLen == 0) return sumNumbers(json, values);
+
+	//arrays are summed per item, missing items are counted as zero
+	Container out = json.array();
+	AutoArray<ConstValue> column;
+	for (natural j = 0; j < arrLen; j++) {
+		column.clear();
+		for (natural i = 0; i < values.length(); i++) {
+			const ConstValue &v = values[i];
+			if (v == null) continue;
+			if (v->getType() == JSON::ndArray) {
+				if (j < v->length()) column.add(v[j]);
+			} else if (j == 0) {
+				column.add(v);
+			}
+		}
+		out.add(sumNumbers(json, column));
+	}
+	return out;
+}
+
+ConstValue View::rereduceCount(const Json &json, const ConstStringT<ConstValue> &values) {
+	//rereduce of the counts is the sum of the counts
+	return sumNumbers(json, values);
+}
+
+static ConstValue combineStats(const Json &json, const ConstStringT<ConstValue> &values) {
+	double sum = 0, sumsqr = 0, minv = 0, maxv = 0;
+	natural count = 0;
+	bool first = true;
+	for (natural i = 0; i < values.length(); i++) {
+		const ConstValue &v = values[i];
+		if (v == null || v->getType() != JSON::ndObject) continue;
+		double vmin = v["min"]->getFloat();
+		double vmax = v["max"]->getFloat();
+		sum += v["sum"]->getFloat();
+		sumsqr += v["sumsqr"]->getFloat();
+		count += v["count"]->getUInt();
+		if (first || vmin < minv) minv = vmin;
+		if (first || vmax > maxv) maxv = vmax;
+		first = false;
+	}
+	return json("sum",sum)("count",count)("min",minv)("max",maxv)("sumsqr",sumsqr);
+}
+
+ConstValue View::rereduceStats(const Json &json, const ConstStringT<ConstValue> &values) {
+	natural arrLen = 0;
+	for (natural i = 0; i < values.length(); i++) {
+		if (values[i] != null && values[i]->getType() == JSON::ndArray && values[i]->length() > arrLen)
+			arrLen = values[i]->length();
+	}
+	if (arrLen == 0) return combineStats(json, values);
+
+	//_stats of the arrays of numbers is the array of the statistics per item
+	Container out = json.array();
+	AutoArray<ConstValue> column;
+	for (natural j = 0; j < arrLen; j++) {
+		column.clear();
+		for (natural i = 0; i < values.length(); i++) {
+			const ConstValue &v = values[i];
+			if (v != null && v->getType() == JSON::ndArray && j < v->length()) column.add(v[j]);
+		}
+		out.add(combineStats(json, column));
+	}
+	return out;
 }
 
 Filter Filter::addArg(ConstStringT<ListArg> args) const {
@@ -92,6 +92,57 @@ public:
 	 */
 	typedef std::function<ConstValue(CouchDB *, ConstValue, ConstValue)> Postprocessing;
 
+	///Function which combines already reduced values (rereduce)
+	/**
+	 * @param Json json builder
+	 * @param ConstStringT<ConstValue> values returned by the reduce function of the view
+	 * @return combined value
+	 *
+	 * The function must follow the semantics of the reduce function of the view called with rereduce=true. It
+	 * allows to calculate coarser group levels from the finer one on the client side (see ReduceCache)
+	 */
+	typedef std::function<ConstValue(const Json &, const ConstStringT<ConstValue> &)> Rereduce;
+
+	///Rereduce for the built-in reduce function _sum
+	/** Numbers are summed, arrays of numbers are summed per item */
+	static ConstValue rereduceSum(const Json &json, const ConstStringT<ConstValue> &values);
+	///Rereduce for the built-in reduce function _count
+	static ConstValue rereduceCount(const Json &json, const ConstStringT<ConstValue> &values);
+	///Rereduce for the built-in reduce function _stats
+	/** Statistics of arrays of numbers (array of objects) are combined per item */
+	static ConstValue rereduceStats(const Json &json, const ConstStringT<ConstValue> &values);
+
+	///Defines how results of the view are cached
+	/**
+	 * Policy is applied only when the connection uses the QueryCache (see Config::cache). Default
+	 * policy (all values zero) keeps the standard behaviour, where each cached result is validated
+	 * by the sequence number or by ETag.
+	 */
+	struct CachePolicy {
+		///Priority of the cached results. Results with lower priority are evicted first
+		enum Priority {
+			priorityLow = 0,
+			priorityNormal = 1,
+			priorityHigh = 2
+		};
+
+		///time in milliseconds, during which the cached result is returned without validation
+		/** Set zero to validate every request (default) */
+		natural ttl;
+		///maximum estimated size of the result in bytes. Larger results are not stored to the cache
+		/** naturalNull means no limit (default) */
+		natural maxSize;
+		///time in milliseconds after the ttl expires, during which the stale result can be returned,
+		///when the server is not available or responds with an error status 5xx
+		natural staleTolerance;
+		///priority of the cached results (see QueryCache::setLimit())
+		Priority priority;
+
+		CachePolicy():ttl(0),maxSize(naturalNull),staleTolerance(0),priority(priorityNormal) {}
+		CachePolicy(natural ttl, natural maxSize = naturalNull, natural staleTolerance = 0, Priority priority = priorityNormal)
+			:ttl(ttl),maxSize(maxSize),staleTolerance(staleTolerance),priority(priority) {}
+	};
+
 	///Declare the view
 	/** Declare single view or list by the path only */
     View(StringA viewPath);
@@ -121,11 +172,26 @@ public:
 
 	View setPath(StringA path) const;
 
+	///Creates copy of the view with different cache policy
+	View setCachePolicy(const CachePolicy &policy) const;
+
+	///Creates copy of the view with the rereduce function
+	/**
+	 * @param fn function which combines reduced values. For the built-in reduce functions
+	 * use rereduceSum, rereduceCount or rereduceStats
+	 */
+	View setRereduce(const Rereduce &fn) const;
+
 
 	const StringA viewPath;
 	const natural flags;
 	const StringCore<ListArg> args;
 	Postprocessing postprocess;
+	CachePolicy cachePolicy;
+	Rereduce rereduce;
+
+protected:
+	View copyWith(StringA viewPath, natural flags, ConstStringT<ListArg> args) const;
 };
 
 ///Define filtering for changes feed
@@ -0,0 +1,136 @@
+/*
+ * viewExporter.cpp
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#include "viewExporter.h"
+
+#include <chrono>
+#include "lightspeed/base/containers/autoArray.tcc"
+#include <lightspeed/base/text/textstream.h>
+#include <lightspeed/utils/json/jsonserializer.tcc>
+
+#include "couchDB.h"
+#include "query.h"
+
+namespace LightCouch {
+
+ViewExporter::ViewExporter(Format format, bool header):format(format),header(header) {
+}
+
+ViewExporter& ViewExporter::column(ConstStrA path, ConstStrA name) {
+	Column c;
+	c.path = path;
+	c.name = name.empty()?path:name;
+	columns.add(c);
+	return *this;
+}
+
+ConstValue ViewExporter::getField(const ConstValue& row, ConstStrA path) {
+	ConstValue cur = row;
+	for (ConstStrA::SplitIterator iter = path.split('.'); iter.hasItems() && cur != null;) {
+		ConstStrA part = iter.getNext();
+		if (cur->getType() == JSON::ndArray) {
+			natural idx = 0;
+			for (natural i = 0; i < part.length(); i++) {
+				if (part[i] < '0' || part[i] > '9') return null;
+				idx = idx * 10 + (part[i] - '0');
+			}
+			if (part.empty() || idx >= cur->length()) return null;
+			cur = cur[idx];
+		} else if (cur->getType() == JSON::ndObject) {
+			cur = cur->getPtr(part);
+		} else {
+			return null;
+		}
+	}
+	return cur;
+}
+
+static void writeCSVString(SeqTextOutA &out, ConstStrA str) {
+	out.write('"');
+	for (ConstStrA::Iterator iter = str.getFwIter(); iter.hasItems();) {
+		char c = iter.getNext();
+		if (c == '"') out.write('"');
+		out.write(c);
+	}
+	out.write('"');
+}
+
+static void writeCSVField(SeqTextOutA &out, const JSON::PFactory &factory, const ConstValue &v) {
+	if (v == null || v->isNull()) return;
+	switch (v->getType()) {
+	case JSON::ndString:
+		writeCSVString(out, v->getStringUtf8());
+		break;
+	case JSON::ndArray:
+	case JSON::ndObject:
+		writeCSVString(out, StringA(factory->toString(*v)));
+		break;
+	default:
+		JSON::serialize(v, out, true);
+		break;
+	}
+}
+
+ViewExporter::Stats ViewExporter::exec(const Query& q, SeqFileOutput out) const {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	AutoArray<Column> cols(columns);
+	if (format == csv && cols.empty()) {
+		static const char *defCols[] = {"id","key","value"};
+		for (natural i = 0; i < 3; i++) {
+			Column c;
+			c.path = c.name = defCols[i];
+			cols.add(c);
+		}
+	}
+	ConstStringT<Column> cl(cols);
+
+	Projection proj;
+	for (natural i = 0; i < cl.length(); i++) proj.add(cl[i].path);
+
+	Stats stats;
+	stats.rows = 0;
+
+	const Json &json = q.json;
+	SeqTextOutA textout(out);
+
+	if (format == csv && header) {
+		for (natural i = 0; i < cl.length(); i++) {
+			if (i) textout.write(',');
+			writeCSVString(textout, cl[i].name);
+		}
+		textout.write('\n');
+	}
+
+	q.streamTokens(Query::RowTokenFn([&](Query::RowParser &p, Query::RowParser::Token r) {
+		//only one row is kept in the memory
+		ConstValue row = cl.empty()?p.parseValue(r, json):proj.parse(p, r, json);
+		if (format == csv) {
+			for (natural i = 0; i < cl.length(); i++) {
+				if (i) textout.write(',');
+				writeCSVField(textout, json.factory, getField(row, cl[i].path));
+			}
+		} else if (cl.empty()) {
+			JSON::serialize(row, textout, true);
+		} else {
+			Container obj = json.object();
+			for (natural i = 0; i < cl.length(); i++) {
+				ConstValue f = getField(row, cl[i].path);
+				obj.set(cl[i].name, f == null?ConstValue(json(null)):f);
+			}
+			JSON::serialize(obj, textout, true);
+		}
+		textout.write('\n');
+		stats.rows++;
+	}));
+
+	stats.duration = natural(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+	return stats;
+}
+
+} /* namespace LightCouch */
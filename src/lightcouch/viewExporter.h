@@ -0,0 +1,98 @@
+/*
+ * viewExporter.h
+ *
+ *  Created on: 19. 10. 2026
+ *      Author: ondra
+ */
+
+#ifndef LIGHTCOUCH_VIEWEXPORTER_H_
+#define LIGHTCOUCH_VIEWEXPORTER_H_
+
+#include "lightspeed/base/containers/autoArray.h"
+#include "lightspeed/base/containers/string.h"
+#include <lightspeed/base/streams/fileio.h>
+
+#include "projection.h"
+
+namespace LightCouch {
+
+using namespace LightSpeed;
+
+class Query;
+
+///Exports result of the view to the stream as NDJSON or CSV
+/**
+ * Rows are read from the response by the streaming parser and written to the output one by one,
+ * so the memory usage doesn't depend on size of the result. It can be used with any view,
+ * including _all_docs (see CouchDB::createQuery(natural))
+ *
+ * Columns are specified as dot separated paths relative to the row, for example "id", "key.0",
+ * "value" or "doc.name". Only selected columns are parsed, other fields are skipped.
+ *
+ * @code
+ * ViewExporter exp(ViewExporter::csv);
+ * exp.column("id").column("doc.name","name").column("doc.age","age");
+ * q.from(20).to(40);
+ * ViewExporter::Stats st = exp.exec(q, out);
+ * @endcode
+ */
+class ViewExporter {
+public:
+
+	enum Format {
+		///one JSON object per line. Without columns, the whole row is written
+		ndjson,
+		///comma separated values. Without columns, the columns id, key and value are written
+		csv
+	};
+
+	///Statistics of the export. They can be used to measure the throughput
+	struct Stats {
+		///count of exported rows
+		natural rows;
+		///duration of the export in milliseconds, including the request
+		natural duration;
+	};
+
+	///Construct the exporter
+	/**
+	 * @param format output format
+	 * @param header write header line with names of the columns (CSV only)
+	 */
+	ViewExporter(Format format, bool header = true);
+
+	///Adds column
+	/**
+	 * @param path dot separated path relative to the row
+	 * @param name name of the column in the header (CSV) or the name of the field (NDJSON). If
+	 * empty, the path is used
+	 * @return reference to this object to create chain
+	 */
+	ViewExporter &column(ConstStrA path, ConstStrA name = ConstStrA());
+
+	///Executes query and writes rows to the output
+	/**
+	 * @param q query to execute. Limit, offset, range, keys, etc are applied as usual. Postprocessing
+	 * function of the view is not called
+	 * @param out output stream
+	 * @return statistics
+	 */
+	Stats exec(const Query &q, SeqFileOutput out) const;
+
+protected:
+
+	struct Column {
+		StringA path;
+		StringA name;
+	};
+
+	Format format;
+	bool header;
+	AutoArray<Column> columns;
+
+	static ConstValue getField(const ConstValue &row, ConstStrA path);
+};
+
+} /* namespace LightCouch */
+
+#endif /* LIGHTCOUCH_VIEWEXPORTER_H_ */
@@ -7,10 +7,28 @@
 #include "../lightcouch/attachment.h"
 #include "../lightcouch/document.h"
 #include "../lightcouch/queryCache.h"
+#include "../lightcouch/documentCache.h"
+#include "../lightcouch/couchDBPool.h"
+#include "../lightcouch/pagedResult.h"
+#include "../lightcouch/parallelScan.h"
+#include "../lightcouch/queryBatch.h"
+#include "../lightcouch/multiDatabaseQuery.h"
+#include "../lightcouch/viewExporter.h"
 #include "../lightcouch/changeset.h"
 #include <lightspeed/base/text/textstream.tcc>
 #include "../lightcouch/couchDB.h"
-#include "../lightcouch/query.h"
+#include "../lightcouch/query.tcc"
+#include "../lightcouch/preparedQuery.h"
+#include "../lightcouch/rowBinding.h"
+#include "../lightcouch/jsonPull.h"
+#include "../lightcouch/projection.h"
+#include "../lightcouch/findQuery.h"
+#include "../lightcouch/cancelToken.h"
+#include "../lightcouch/columnarResult.h"
+#include "../lightcouch/groupAggregator.h"
+#include "../lightcouch/reduceCache.h"
+#include "../lightcouch/queryProfile.h"
+#include "../lightcouch/exception.h"
 #include "../lightcouch/changes.h"
 #include "lightspeed/base/framework/testapp.h"
 
@@ -197,6 +215,728 @@ static void couchFindKeys(PrintTextA &a) {
 	}
 }
 
+static void couchPreparedQuery(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_name));
+	PreparedQuery pq(q, PreparedQuery::shapeKey);
+	const char *names[] = {"Kermit Byrd","Owen Dillard","Nicole Jordan"};
+	for (natural i = 0; i < countof(names); i++) {
+		Container key = db.json.array();
+		key.add(db.json(ConstStrA(names[i])));
+		Result res = pq.exec(key);
+		while (res.hasItems()) {
+			Row row = res.getNext();
+			a("%1,%2,%3 ") << row.key[0]->getStringUtf8()
+					<<row.value[0]->getUInt()
+					<<row.value[1]->getUInt();
+		}
+	}
+}
+
+static void couchJoin(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age));
+	Query qname(db.createQuery(by_name));
+	Result res = q.from(40).to(50).exec().join(qname, "person", Result::joinFirstRow,
+			[&](const ConstValue &row) -> ConstValue {
+		Container key = db.json.array();
+		key.add(row["value"]);
+		return key;
+	});
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1:%2 ") << row.value->getStringUtf8() << row["person"][1]->getUInt();
+	}
+}
+
+static void couchJoinNumeric(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_name));
+	Query qage(db.createQuery(by_age));
+	Result res = q.select("Kermit Byrd")(Query::isArray).select("Nicole Jordan")(Query::isArray)
+			.exec().join(qage, "byAge", Result::joinFirstRow,
+			[&](const ConstValue &row) -> ConstValue {
+		//floating point key must match the integer key of the view
+		return db.json(row["value"][0]->getFloat());
+	});
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		if (row["byAge"] == null) a("missing ");
+		else a("%1 ") << row["byAge"]->getStringUtf8();
+	}
+}
+
+static void couchSortByKey(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age));
+	Result res = q.from(40).to(50).exec().sortByKey([](const ConstValue &row) {
+		return row["value"];
+	});
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1 ") << row.value->getStringUtf8();
+	}
+
+	//rows with equal keys keep their order in the descending order too
+	Result res2 = q.reset().from(40).exec().sortByKey([&](const ConstValue &row) {
+		return db.json(row["key"]->getUInt() / 10 * 10);
+	}, true);
+	a("| ");
+	while (res2.hasItems()) {
+		Row row = res2.getNext();
+		a("%1 ") << row.key->getUInt();
+	}
+}
+
+static Result keysToResult(const Json &json, const char *keys) {
+	ConstValue k = json.factory->fromString(keys);
+	Container rows = json.array();
+	for (natural i = 0, cnt = k.length(); i < cnt; i++) {
+		rows.add(json("key",static_cast<const Value &>(k[i])));
+	}
+	return Result(json, json("rows",rows));
+}
+
+static void couchCollation(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+
+	//order of the strings as returned by the view
+	Result res = keysToResult(db.json, "[\"B\",\"aa\",\"b\",\"A\",\"a\",\"\\u00e1\",\"_\",\"1\"]")
+			.sortByKey([](const ConstValue &row) {return row["key"];});
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1 ") << row.key->getStringUtf8();
+	}
+
+	//ICU ordered inputs
+	Result parts[] = {
+			keysToResult(db.json, "[\"a\",\"B\"]"),
+			keysToResult(db.json, "[\"B\"]")
+	};
+	Result res2 = Result::mergeMany(db.json, ConstStringT<Result>(parts,countof(parts)), mergeIntersection);
+	a("|");
+	while (res2.hasItems()) {
+		Row row = res2.getNext();
+		a(" %1") << row.key->getStringUtf8();
+	}
+}
+
+static void couchMergeMany(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age));
+	Result parts[] = {
+			q.from(20).to(50).exec(),
+			q.reset().from(40).to(80).exec(),
+			q.reset().from(30).to(60).exec()
+	};
+	Result res = Result::mergeMany(db.json, ConstStringT<Result>(parts,countof(parts)), mergeIntersection);
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1 ") << row.key->getUInt();
+	}
+}
+
+static void couchPagedResult(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age));
+	PagedResult res(q, 5);
+	while (res.hasItems()) {
+		Row row(res.getNext());
+		a("%1 ") << row.key->getUInt();
+	}
+	a("%1 | ") << res.getPageCount();
+
+	//the same with the prefetch through the pool
+	CouchDBPool pool(getTestCouch(), 2, 60000, 60000);
+	q.reset();
+	PagedResult res2(q, 5, pool);
+	while (res2.hasItems()) {
+		Row row(res2.getNext());
+		a("%1 ") << row.key->getUInt();
+	}
+	a("%1") << res2.getPageCount();
+}
+
+static StringA rowIds(Result res) {
+	StringA out;
+	while (res.hasItems()) {
+		Row row(res.getNext());
+		out = out + row.id.getStringA() + ConstStrA(' ');
+	}
+	return out;
+}
+
+static void couchParallelScan(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+	Result full = db.createQuery(by_age_group).exec();
+	StringA fullIds = rowIds(full);
+
+	Config cfg = getTestCouch();
+	cfg.databaseName = DATABASENAME;
+	CouchDBPool pool(cfg, 4, 60000, 60000);
+
+	//sampled boundaries are keys of existing rows
+	ParallelScan scan(pool, by_age_group, 4);
+	Result res = scan.exec();
+	a("%1,%2,") << res.length() << (rowIds(res) == fullIds?"same":"differ");
+
+	//row equal to the boundary belongs to the following partition only
+	ParallelScan scan2(pool, by_age_group, 3);
+	scan2.setBoundaries(db.json.factory->fromString("[[40,43],[75]]"));
+	Result res2 = scan2.exec();
+	a("%1,%2") << res2.length() << (rowIds(res2) == fullIds?"same":"differ");
+}
+
+static void runQueryBatch(PrintTextA &a, QueryBatch &batch, CouchDB &db) {
+	Query q1(db.createQuery(by_age));
+	Query q2(db.createQuery(by_name));
+	batch.add(q1.from(40).to(50));
+	batch.add(q1.reset().from(70).to(80));
+	batch.add(q2.select("Kermit Byrd")(Query::isArray));
+	AutoArray<Result> res = batch.exec();
+	for (natural i = 0; i < res.length(); i++) {
+		a("%1 ") << res[i].length();
+	}
+}
+
+static void couchQueryBatch(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+	//pooled connections have no database selected
+	CouchDBPool pool(getTestCouch(), 4, 60000, 60000);
+
+	QueryBatch batch(db, &pool);
+	runQueryBatch(a, batch, db);
+	a("| ");
+	//fallback executes the queries in parallel through the pool
+	QueryBatch batch2(db, &pool);
+	batch2.disableBatch();
+	runQueryBatch(a, batch2, db);
+
+	//queries of other database must not be sent with the queries of the same view
+	CouchDB db2(getTestCouch());
+	db2.use("lightcouch_unittest_batch");
+	db2.createDatabase();
+	for (natural i = 0; i < countof(designs); i++) {
+		db2.uploadDesignDocument(designs[i],strlen(designs[i]));
+	}
+	QueryBatch batch3(db);
+	Query q1(db.createQuery(by_age));
+	Query q2(db2.createQuery(by_age));
+	batch3.add(q1.from(40).to(50));
+	batch3.add(q2.from(40).to(50));
+	batch3.add(q1.reset().from(70).to(80));
+	AutoArray<Result> res = batch3.exec();
+	a("| %1 %2 %3 ") << res[0].length() << res[1].length() << res[2].length();
+	db2.deleteDatabase();
+
+	//arguments of the view keep their type in the body of the batch
+	View::ListArg arg;
+	arg.key = "inclusive_end";
+	arg.value = "false";
+	Query q3(db.createQuery(by_age.addArg(ConstStringT<View::ListArg>(&arg,1))));
+	a("| %1") << (q3.getQueryObject()["inclusive_end"]->getType() == JSON::ndBool?"bool":"string");
+}
+
+static void couchSplitKeys(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+	//pooled connections have no database selected
+	CouchDBPool pool(getTestCouch(), 4, 60000, 60000);
+
+	Query q(db.createQuery(by_age));
+	q.splitKeys(2, &pool);
+	static const natural ages[] = {80,21,99,43,36,47,42};
+	for (natural i = 0; i < countof(ages); i++) q.select(ages[i]);
+	Result res = q.exec();
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1 ") << row.key->getUInt();
+	}
+
+	//reduce without grouping is never split
+	Query q2(db.createQuery(age_group_height));
+	q2.splitKeys(2, &pool);
+	q2.group(0);
+	q2.select(40)(42).select(40)(43).select(40)(44);
+	Result res2 = q2.exec();
+	a("| %1,%2") << res2.length() << Row(res2.getNext()).value["count"]->getUInt();
+
+	//grouped reduce, the last chunk has one key only, it must not be grouped by the group level
+	Query q3(db.createQuery(age_group_height));
+	q3.splitKeys(2, &pool);
+	q3.group(1);
+	q3.select(40)(42).select(40)(43).select(40)(44);
+	Result res3 = q3.exec();
+	a(" |");
+	while (res3.hasItems()) {
+		Row row = res3.getNext();
+		a(" %1:%2") << row.key->length() << row.value["count"]->getUInt();
+	}
+}
+
+static void couchMultiDatabase(PrintTextA &a) {
+
+	ConstStrA tenant = "lightcouch_unittest_tenant";
+	CouchDB db(getTestCouch());
+	db.use(tenant);
+	db.createDatabase();
+	for (natural i = 0; i < countof(designs); i++) {
+		db.uploadDesignDocument(designs[i],strlen(designs[i]));
+	}
+	Document doc;
+	doc.edit(db.json)("name","Tenant Person")("age",45)("height",170);
+	Changeset chset(db.createChangeset());
+	chset.update(doc);
+	chset.commit(false);
+
+	//single connection switches between the databases, both use the same cache
+	QueryCache cache;
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	CouchDBPool pool(cfg, 1, 60000, 60000);
+	MultiDatabaseQuery mq(pool, 1);
+	mq.add(DATABASENAME).add(tenant);
+
+	//the ttl returns cached results without validation, so a wrong key would mix the tenants
+	Query q(db.createQuery(by_age.setCachePolicy(View::CachePolicy(60000))));
+	q.from(40).to(50);
+	for (natural i = 0; i < 2; i++) {
+		AutoArray<Result> res = mq.execEach(q);
+		a("%1,%2,") << res[0].length() << res[1].length();
+	}
+	a("%1") << mq.exec(q).length();
+
+	db.deleteDatabase();
+}
+
+static void couchPartitioned(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use("lightcouch_unittest_partitioned");
+	db.createDatabase(true);
+	for (natural i = 0; i < countof(designs); i++) {
+		db.uploadDesignDocument(designs[i],strlen(designs[i]));
+	}
+
+	static const char *partitions[] = {"p1","p2","p1"};
+	static const natural ages[] = {40,35,30};
+	Changeset chset(db.createChangeset());
+	for (natural i = 0; i < countof(ages); i++) {
+		Document doc(db.newPartitionedDocument(partitions[i]));
+		doc.edit(db.json)("name","Partitioned Person")("age",ages[i]);
+		chset.update(doc);
+	}
+	chset.commit(false);
+
+	Query q(db.createQuery(by_age));
+	q.partition("p1");
+	Result res = q.exec();
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1 ") << row.key->getUInt();
+	}
+	a("|%1") << db.getPartitionInfo("p1")["doc_count"]->getUInt();
+
+	db.deleteDatabase();
+}
+
+static StringA exportToString(const ViewExporter &exp, const Query &q) {
+	ConstStrW fileName = L"lightcouch_unittest_export.txt";
+	exp.exec(q, SeqFileOutput(fileName, OpenFlags::create|OpenFlags::truncate));
+	AutoArray<char> content;
+	SeqFileInput in(fileName, 0);
+	while (in.hasItems()) content.add(in.getNext());
+	return StringA(ConstStrA(content));
+}
+
+static void couchExport(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age_group));
+	q.from(70)(0);
+
+	ViewExporter csv(ViewExporter::csv);
+	csv.column("key.0","group").column("key.1","age").column("value","full \"name\"");
+	a("%1") << exportToString(csv, q);
+
+	ViewExporter ndjson(ViewExporter::ndjson);
+	ndjson.column("key.1","age").column("value","name");
+	a("%1") << exportToString(ndjson, q);
+}
+
+struct AgeRow {
+	natural age;
+	StringA name;
+	StringA id;
+};
+
+static void couchRowBinding(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	RowBinding<AgeRow> binding;
+	binding.bind("key", &AgeRow::age).bind("value", &AgeRow::name).bind("id", &AgeRow::id);
+	Query q(db.createQuery(by_age));
+	q.from(40).to(50);
+	AutoArray<AgeRow> rows = q.exec(binding);
+	for (natural i = 0; i < rows.length(); i++) {
+		if (rows[i].age >= 40 && rows[i].age <= 50 && !rows[i].id.empty())
+			a("%1 ") << rows[i].name;
+	}
+}
+
+static void jsonPullParser(PrintTextA &a) {
+
+	//the first input is valid, others must be rejected
+	static const char *inputs[] = {
+		"{\"a\":[1,-2.5e3,\"\\uD83D\\uDE00\"],\"b\":{}}",
+		"[1,]", "{\"a\" 1}", "[1 2]", "[\"\\uD83D\\u0041\"]", "[\"abc\\", "[1-2]"
+	};
+	Json json(JSON::create());
+	for (natural i = 0; i < countof(inputs); i++) {
+		ConstStrA text(inputs[i]);
+		ConstStrA::Iterator iter = text.getFwIter();
+		JsonPullParser<ConstStrA::Iterator> p(iter);
+		try {
+			p.parseValue(p.next(), json);
+			a("ok ");
+		} catch (const ErrorMessageException &) {
+			a("error ");
+		}
+	}
+}
+
+static void couchProjection(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_name_cacheable));
+	Result res = q.select("Kermit Byrd")(Query::isArray).project("doc.height").exec();
+	Row row = res.getNext();
+	a("%1,%2") << row.doc["height"]->getUInt() << (row.doc->getPtr("name")?"kept":"skipped");
+
+	ConstValue doc = db.retrieveDocument(row.id.getStringA(), Projection().add("age"));
+	a(",%1,%2") << doc["age"]->getUInt() << (doc->getPtr("height")?"kept":"skipped");
+}
+
+static void couchFind(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	FindQuery fq(db);
+	Container fields = db.json.array();
+	fields.add(db.json("age"));
+	fq.createIndex(fields, "by_age_idx", "testfind");
+
+	FindResult res = fq.selector(db.json("age",db.json("$gt",40)))
+			.field("name").sort("age").limit(3).exec();
+	while (res.hasItems()) {
+		a("%1 ") << res.getNext()["name"]->getStringUtf8();
+	}
+	a("| ");
+	FindResult res2 = fq.bookmark(res.getBookmark()).exec();
+	while (res2.hasItems()) {
+		a("%1 ") << res2.getNext()["name"]->getStringUtf8();
+	}
+}
+
+static void couchCancelQuery(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(by_age));
+	q.from(40).to(50);
+	CancelToken expired(0);
+	try {
+		q.exec(expired);
+		a("not canceled");
+	} catch (DeadlineExceededException &) {
+		a("deadline");
+	}
+	CancelToken canceled;
+	canceled.cancel();
+	try {
+		q.exec(canceled);
+		a(",not canceled");
+	} catch (CanceledException &) {
+		a(",canceled");
+	}
+	//connection is still usable
+	CancelToken token(10000);
+	Result res = q.exec(token);
+	a(",%1") << res->length();
+}
+
+static void couchColumnar(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Query q(db.createQuery(age_group_height));
+	q(40)(Query::any);
+	ColumnarResult res = ColumnarResult::exec(q);
+	a("%1,%2,%3,%4") << res.length() << res.getKeyCount()
+			<< (res.getValue().getType() == ColumnarResult::typeInt?"int":"other")
+			<< natural(res.getValue().sum());
+}
+
+static void couchGroupSorted(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	Result::ReduceFunction countFn = [&db](const ConstStringT<ConstValue> &rows) -> ConstValue {
+		return db.json("key",rows[0]["key"][0])("value",rows.length());
+	};
+
+	Query q(db.createQuery(by_age_group));
+	Result res = q.exec().groupSorted(1, countFn);
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1:%2 ") << row.key->getUInt() << row.value->getUInt();
+	}
+	a("| ");
+
+	Query q2(db.createQuery(by_age_group));
+	GroupAggregator agg(1, countFn, [&](const ConstValue &row) {
+		a("%1:%2 ") << row["key"]->getUInt() << row["value"]->getUInt();
+	});
+	agg.exec(q2);
+}
+
+static void couchProfiledQuery(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	QueryProfile profile;
+	Query q(db.createQuery(by_name));
+	Result res = q.execProfiled(profile);
+	bool consistent = profile.bytes > 0 && profile.total >= profile.firstByte + profile.transfer + profile.parse;
+	a("%1,%2,%3,%4") << res.length() << profile.requests << profile.cacheHits << (consistent?"ok":"inconsistent");
+}
+
+static void couchDeployDesign(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	ConstValue ddoc = db.json("language","javascript")
+			("views",db.json("by_age",db.json("map","function (doc) {emit(doc.age, doc.name);}")));
+	CouchDB::DeployProgress::Phase lastPhase = CouchDB::DeployProgress::phaseUpload;
+	bool deployed = db.deployDesignDocument(ddoc, "deploytest", [&](const CouchDB::DeployProgress &p) {
+		lastPhase = p.phase;
+	}, 100);
+
+	Query q(db.createQuery(View("_design/deploytest/_view/by_age")));
+	q.from(40).to(50);
+	Result res = q.exec();
+	bool stagingExists = true;
+	try {
+		db.retrieveDocument("_design/deploytest-staging", CouchDB::flgDisableCache);
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() == 404) stagingExists = false; else throw;
+	}
+	a("%1,%2,%3,%4") << (deployed?"deployed":"unchanged")
+			<< (lastPhase == CouchDB::DeployProgress::phaseDone?"done":"incomplete")
+			<< res.length() << (stagingExists?"staging":"clean");
+}
+
+static void couchRedeployDesign(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	ConstValue v1 = db.json("language","javascript")
+			("views",db.json("by_age",db.json("map","function (doc) {emit(doc.age, doc.name);}")));
+	//_id and _rev of the content must not be stored to the staging nor to the live document
+	ConstValue v2 = db.json("_id","_design/redeploytest-staging")
+			("_rev","1-00000000000000000000000000000000")
+			("language","javascript")
+			("views",db.json("by_age",db.json("map","function (doc) {emit(doc.age, doc.height);}")));
+
+	bool first = db.deployDesignDocument(v1, "redeploytest", CouchDB::DeployProgressFn(), 100);
+	bool same = db.deployDesignDocument(v1, "redeploytest", CouchDB::DeployProgressFn(), 100);
+	bool second = db.deployDesignDocument(v2, "redeploytest", CouchDB::DeployProgressFn(), 100);
+
+	Query q(db.createQuery(View("_design/redeploytest/_view/by_age")));
+	q.from(40).to(50);
+	Result res = q.exec();
+	Row row = res.getNext();
+	bool stagingExists = true;
+	try {
+		db.retrieveDocument("_design/redeploytest-staging", CouchDB::flgDisableCache);
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() == 404) stagingExists = false; else throw;
+	}
+	a("%1,%2,%3,%4,%5,%6") << (first?"deployed":"unchanged")
+			<< (same?"deployed":"unchanged")
+			<< (second?"deployed":"unchanged")
+			<< res.length() << (row.value->getType() == JSON::ndString?"name":"height")
+			<< (stagingExists?"staging":"clean");
+}
+
+static void couchDeployCanceled(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	ConstValue ddoc = db.json("language","javascript")
+			("views",db.json("by_height",db.json("map","function (doc) {emit(doc.height, doc.name);}")));
+	//the token is canceled once the staging document is uploaded
+	CancelToken token;
+	try {
+		CouchDB::CancelScope _(db, &token);
+		db.deployDesignDocument(ddoc, "canceltest", [&](const CouchDB::DeployProgress &p) {
+			if (p.phase == CouchDB::DeployProgress::phaseIndexing) token.cancel();
+		}, 100);
+		a("deployed");
+	} catch (CanceledException &) {
+		a("canceled");
+	}
+
+	bool stagingExists = true, liveExists = true;
+	try {
+		db.retrieveDocument("_design/canceltest-staging", CouchDB::flgDisableCache);
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() == 404) stagingExists = false; else throw;
+	}
+	try {
+		db.retrieveDocument("_design/canceltest", CouchDB::flgDisableCache);
+	} catch (HttpStatusException &e) {
+		if (e.getStatus() == 404) liveExists = false; else throw;
+	}
+	a(",%1,%2") << (stagingExists?"staging":"clean") << (liveExists?"live":"none");
+}
+
+static void couchDocumentCache(PrintTextA &a) {
+
+	DocumentCache dcache;
+	Config cfg = getTestCouch();
+	cfg.docCache = &dcache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+
+	Document doc = db.newDocument(".dc");
+	doc.edit(db.json)("counter",1);
+	Changeset chset(db.createChangeset());
+	chset.update(doc);
+	chset.commit(false);
+	StringA docId = doc.getID();
+
+	//committed document is stored to the cache (write-through)
+	DocumentCache::CachedDoc cdoc = dcache.find(DATABASENAME, docId);
+	a("%1,") << (cdoc.isDefined() && cdoc.rev == doc.getRev()?"cached":"missing");
+
+	//update through the connection without the cache, cached connection doesn't see it
+	ConstValue since = db.getLastSeqNumber();
+	CouchDB db2(getTestCouch());
+	db2.use(DATABASENAME);
+	Document doc2 = db2.retrieveDocument(docId);
+	doc2.edit(db2.json)("counter",2);
+	Changeset chset2(db2.createChangeset());
+	chset2.update(doc2);
+	chset2.commit(false);
+	a("%1,") << db.retrieveDocument(docId)["counter"]->getUInt();
+
+	//new revision reported by the changes feed invalidates the cached document
+	db.createChangesSink().fromSeq(since).exec();
+	a("%1") << db.retrieveDocument(docId)["counter"]->getUInt();
+
+	//the document has no height, it must not stay in the database for the reduce tests
+	Changeset chset3(db2.createChangeset());
+	chset3.erase(doc2["_id"],doc2["_rev"]);
+	chset3.commit(false);
+
+	//the least recently used document is evicted, once the limit is exceeded
+	DocumentCache small;
+	small.setLimit(2);
+	ConstValue docA = db.json("_id","a")("_rev","1-a");
+	ConstValue docB = db.json("_id","b")("_rev","1-b");
+	ConstValue docC = db.json("_id","c")("_rev","1-c");
+	small.set(DATABASENAME, docA);
+	small.set(DATABASENAME, docB);
+	small.find(DATABASENAME, "a");
+	small.set(DATABASENAME, docC);
+	a(",%1,%2%3%4") << small.size()
+			<< (small.find(DATABASENAME, "a").isDefined()?"a":"")
+			<< (small.find(DATABASENAME, "b").isDefined()?"b":"")
+			<< (small.find(DATABASENAME, "c").isDefined()?"c":"");
+}
+
+static void couchDocumentCacheMissing(PrintTextA &a) {
+
+	QueryCache cache;
+	DocumentCache dcache;
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	cfg.docCache = &dcache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+	ConstStrA docId = "lightcouch_missing_doc";
+
+	//without negative caching, the "not found" is not stored
+	try {db.retrieveDocument(docId);} catch (const HttpStatusException &e) {a("%1,") << e.getStatus();}
+	a("%1,") << (dcache.find(DATABASENAME,docId).missing?"stored":"none");
+
+	//negative record requires tracked sequence numbers
+	dcache.enableNegativeCaching(true);
+	db.trackSeqNumbers();
+	try {db.retrieveDocument(docId);} catch (const HttpStatusException &e) {a("%1,") << e.getStatus();}
+	a("%1,") << (dcache.find(DATABASENAME,docId).missing?"stored":"none");
+
+	//create the document through the connection without caches
+	CouchDB db2(getTestCouch());
+	db2.use(DATABASENAME);
+	Document doc = db2.newDocument();
+	doc.edit(db2.json)("counter",1);
+	doc.setID(db2.json(docId));
+	Changeset chset(db2.createChangeset());
+	chset.update(doc);
+	chset.commit(false);
+
+	//sequence number didn't change yet, so the record is still valid
+	try {db.retrieveDocument(docId);} catch (const HttpStatusException &e) {a("%1,") << e.getStatus();}
+
+	//reading the changes updates the sequence number, which invalidates the record
+	db.getLastSeqNumber();
+	a("%1") << db.retrieveDocument(docId)["counter"]->getUInt();
+
+	Changeset chset2(db2.createChangeset());
+	chset2.erase(doc["_id"],doc["_rev"]);
+	chset2.commit(false);
+}
+
 static void couchCaching(PrintTextA &a) {
 
 	QueryCache cache;
@@ -226,6 +966,144 @@ static void couchCaching(PrintTextA &a) {
 
 }
 
+static void couchCacheStats(PrintTextA &a) {
+
+	QueryCache cache;
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+
+	for (natural i = 0; i < 3; i++) {
+		Query q(db.createQuery(by_name_cacheable));
+		q.select("Kermit Byrd")(Query::isArray)
+		 .select("Owen Dillard")
+		 .select("Nicole Jordan")
+		 .exec();
+	}
+	const QueryCache::Counters &c = cache.getStats().categories[QueryCache::catView];
+	a("%1,%2,%3,%4,%5") << natural(c.hits) << natural(c.revalidations)
+			<< natural(c.misses) << natural(c.sets) << natural(cache.getStats().items);
+
+	//the key contains the database, but the category is determined by the relative path
+	db.requestGET("_all_docs?limit=1");
+	const QueryCache::Counters &other = cache.getStats().categories[QueryCache::catOther];
+	const QueryCache::Counters &docs = cache.getStats().categories[QueryCache::catDocument];
+	a(",%1,%2,%3") << natural(other.misses) << natural(other.sets) << natural(docs.sets);
+}
+
+static void couchAccessLog(PrintTextA &a) {
+
+	QueryCache cache;
+	cache.enableAccessLog(true);
+	cache.setAccessLogLimit(4);
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+
+	ConstStrA hotPath = "_all_docs?limit=1";
+	for (natural i = 0; i < 5; i++) db.requestGET(hotPath);
+	//flood the log with cold paths, it must stay bounded and keep the hot path
+	for (natural i = 0; i < 20; i++) {
+		db.requestGET(StringA(ConstStrA("_all_docs?limit=0&skip=") + ToString<natural>(i)));
+	}
+
+	ConstStrW logName = L"lightcouch_unittest_access.json";
+	cache.saveAccessLog(logName);
+	SeqFileInput logFile(logName,0);
+	ConstValue log = db.json.factory->fromStream(logFile);
+
+	QueryCache cache2;
+	Config cfg2 = getTestCouch();
+	cfg2.cache = &cache2;
+	CouchDBPool pool(cfg2, 4, 60000, 60000);
+	natural loaded = cache2.warmUp(pool, logName);
+
+	//warmed items are validated by the sequence number, so they are served directly
+	CouchDB db3(cfg2);
+	db3.use(DATABASENAME);
+	db3.trackSeqNumbers();
+	db3.requestGET(hotPath);
+
+	a("%1,%2,%3,%4,%5") << log->length()
+			<< (log[0]["path"].getStringA() == hotPath?"hot":"cold")
+			<< loaded << natural(cache2.getStats().items)
+			<< natural(cache2.getStats().categories[QueryCache::catOther].hits);
+}
+
+static void couchCachePolicy(PrintTextA &a) {
+
+	QueryCache cache;
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+
+	const QueryCache::Counters &c = cache.getStats().categories[QueryCache::catView];
+	auto report = [&] {
+		a("%1,%2,%3 ") << natural(c.hits) << natural(c.revalidations) << natural(c.misses);
+	};
+
+	View::CachePolicy policy(500);
+	View v = by_name_cacheable.setCachePolicy(policy);
+	for (natural i = 0; i < 4; i++) {
+		//the third query is made after the ttl expired, so it must be revalidated
+		//the revalidation renews the ttl, so the fourth query is served directly
+		if (i == 2) Thread::sleep(600);
+		Query q(db.createQuery(v));
+		q.select("Kermit Byrd")(Query::isArray).exec();
+		report();
+	}
+
+	ConstStrA path = "_design/testview/_view/by_name?limit=1";
+	db.requestGET(path, policy);
+	report();
+	db.requestGET(path, policy);
+	report();
+	//refresh ignores the ttl
+	db.requestGET(path, policy, null, CouchDB::flgRefreshCache);
+	report();
+}
+
+static void couchStaleCanceled(PrintTextA &a) {
+
+	QueryCache cache;
+	Config cfg = getTestCouch();
+	cfg.cache = &cache;
+	CouchDB db(cfg);
+	db.use(DATABASENAME);
+
+	ConstValue ddoc = db.json("language","javascript")
+			("shows",db.json("slow","function(doc, req) {var t = new Date().getTime();"
+					"while (new Date().getTime() - t < 1000) {} return {json: {ok: true}};}"));
+	db.uploadDesignDocument(ddoc, CouchDB::ddurOverwrite, "slowtest");
+
+	//ttl expires immediately, stale result is allowed for a minute
+	View::CachePolicy policy(1, naturalNull, 60000);
+	ConstStrA path = "_design/slowtest/_show/slow";
+	db.requestGET(path, policy);
+	a("%1,") << natural(cache.getStats().items);
+	Thread::sleep(10);
+
+	//the deadline expires while the server is working, the stale result must not be returned
+	CancelToken token(300);
+	try {
+		CouchDB::CancelScope _(db, &token);
+		db.requestGET(path, policy);
+		a("stale");
+	} catch (DeadlineExceededException &) {
+		a("deadline");
+	}
+	//connection is still usable
+	a(",%1") << (db.requestGET(path, policy)["ok"]->getBool()?"ok":"fail");
+
+	ConstValue stored = db.retrieveDocument("_design/slowtest", CouchDB::flgDisableCache);
+	Changeset chset(db.createChangeset());
+	chset.erase(stored["_id"], stored["_rev"]);
+	chset.commit(false);
+}
+
 static void couchCaching2(PrintTextA &a) {
 
 	QueryCache cache;
@@ -290,6 +1168,50 @@ static void couchReduce(PrintTextA &a) {
 	}
 }
 
+static void couchReduceCache(PrintTextA &a) {
+
+	CouchDB db(getTestCouch());
+	db.use(DATABASENAME);
+
+	ReduceCache cache(2);
+	Query q(db.createQuery(age_group_height.setRereduce(&View::rereduceStats)));
+	q.group(1);
+	Result res = cache.exec(q);
+
+	while (res.hasItems()) {
+		Row row = res.getNext();
+		a("%1:%2 ") << row.key[0]->getUInt()
+				<<(row.value["sum"]->getUInt()/row.value["count"]->getUInt());
+	}
+	q.reset();
+	q.group(0);
+	Result total = cache.exec(q);
+	a("|%1,%2") << total[0]["value"]["count"]->getUInt() << cache.size();
+
+	//cache holds at most one result
+	ReduceCache small(2, 1);
+	Query q2(db.createQuery(age_group_height.setRereduce(&View::rereduceStats)));
+	q2.group(1);
+	small.exec(q2);
+	q2.reset();
+	q2.group(1);
+	q2.from(40)(0);
+	small.exec(q2);
+	a(",%1") << small.size();
+
+	//_stats of arrays are combined per item
+	ConstValue arr = db.json.factory->fromString("[[{\"sum\":10,\"count\":2,\"min\":4,\"max\":6,\"sumsqr\":52},"
+			"{\"sum\":1,\"count\":1,\"min\":1,\"max\":1,\"sumsqr\":1}],"
+			"[{\"sum\":5,\"count\":1,\"min\":5,\"max\":5,\"sumsqr\":25},"
+			"{\"sum\":3,\"count\":1,\"min\":3,\"max\":3,\"sumsqr\":9}]]");
+	AutoArray<ConstValue> values;
+	values.add(arr[0]);
+	values.add(arr[1]);
+	ConstValue st = View::rereduceStats(db.json, ConstStringT<ConstValue>(values));
+	a(",%1:%2,%3:%4") << st[0]["count"]->getUInt() << st[0]["max"]->getUInt()
+			<< st[1]["sum"]->getUInt() << st[1]["min"]->getUInt();
+}
+
 
 static ConstValue lastId;
 
@@ -472,9 +1394,40 @@ defineTest test_couchFindWildcard("couchdb.findWildcard","Kenneth Meyer,42,156 K
 defineTest test_couchFindGroup("couchdb.findGroup","Kenneth Meyer Scarlett Frazier Odette Hahn Pascale Burt Bevis Bowen ",&couchFindGroup);
 defineTest test_couchFindRange("couchdb.findRange","Daniel Cochran Ramona Lang Urielle Pennington ",&couchFindRange);
 defineTest test_couchFindKeys("couchdb.findKeys","Kermit Byrd,76,184 Owen Dillard,80,151 Nicole Jordan,75,150 ",&couchFindKeys);
+defineTest test_couchPreparedQuery("couchdb.preparedQuery","Kermit Byrd,76,184 Owen Dillard,80,151 Nicole Jordan,75,150 ",&couchPreparedQuery);
+defineTest test_couchJoin("couchdb.join","Kenneth Meyer:156 Scarlett Frazier:183 Odette Hahn:181 Pascale Burt:153 Bevis Bowen:185 ",&couchJoin);
+defineTest test_couchJoinNumeric("couchdb.joinNumeric","Kermit Byrd Nicole Jordan ",&couchJoinNumeric);
+defineTest test_couchSortByKey("couchdb.sortByKey","Bevis Bowen Kenneth Meyer Odette Hahn Pascale Burt Scarlett Frazier | 80 75 76 52 42 43 44 46 47 ",&couchSortByKey);
+defineTest test_couchCollation("couchdb.collation","_ 1 a A \xC3\xA1 aa b B | B",&couchCollation);
+defineTest test_couchMergeMany("couchdb.mergeMany","42 43 44 46 47 ",&couchMergeMany);
+defineTest test_couchPagedResult("couchdb.pagedResult","21 23 36 42 43 44 46 47 52 75 76 80 3 | 21 23 36 42 43 44 46 47 52 75 76 80 3",&couchPagedResult);
+defineTest test_couchParallelScan("couchdb.parallelScan","12,same,12,same",&couchParallelScan);
+defineTest test_couchQueryBatch("couchdb.queryBatch","5 3 1 | 5 3 1 | 5 0 3 | bool",&couchQueryBatch);
+defineTest test_couchSplitKeys("couchdb.splitKeys","80 21 43 36 47 42 | 1,3 | 2:1 2:1 2:1",&couchSplitKeys);
+defineTest test_couchMultiDatabase("couchdb.multiDatabase","5,1,5,1,6",&couchMultiDatabase);
+defineTest test_couchPartitioned("couchdb.partitioned","30 40 |2",&couchPartitioned);
+defineTest test_couchExport("couchdb.export","\"group\",\"age\",\"full \"\"name\"\"\"\n70,75,\"Nicole Jordan\"\n70,76,\"Kermit Byrd\"\n80,80,\"Owen Dillard\"\n{\"age\":75,\"name\":\"Nicole Jordan\"}\n{\"age\":76,\"name\":\"Kermit Byrd\"}\n{\"age\":80,\"name\":\"Owen Dillard\"}\n",&couchExport);
+defineTest test_couchRowBinding("couchdb.rowBinding","Kenneth Meyer Scarlett Frazier Odette Hahn Pascale Burt Bevis Bowen ",&couchRowBinding);
+defineTest test_jsonPullParser("couchdb.jsonPull","ok error error error error error error ",&jsonPullParser);
+defineTest test_couchProjection("couchdb.projection","184,skipped,76,skipped",&couchProjection);
+defineTest test_couchFind("couchdb.find","Kenneth Meyer Scarlett Frazier Odette Hahn | Pascale Burt Bevis Bowen Dakota Shepherd ",&couchFind);
+defineTest test_couchCancelQuery("couchdb.cancelQuery","deadline,canceled,5",&couchCancelQuery);
+defineTest test_couchColumnar("couchdb.columnar","5,2,int,858",&couchColumnar);
+defineTest test_couchProfiledQuery("couchdb.profiledQuery","12,1,0,ok",&couchProfiledQuery);
+defineTest test_couchDeployDesign("couchdb.deployDesign","deployed,done,5,clean",&couchDeployDesign);
+defineTest test_couchRedeployDesign("couchdb.redeployDesign","deployed,unchanged,deployed,5,height,clean",&couchRedeployDesign);
+defineTest test_couchDeployCanceled("couchdb.deployCanceled","canceled,clean,none",&couchDeployCanceled);
+defineTest test_couchGroupSorted("couchdb.groupSorted","20:2 30:1 40:5 50:1 70:2 80:1 | 20:2 30:1 40:5 50:1 70:2 80:1 ",&couchGroupSorted);
 defineTest test_couchRetrieveDocument("couchdb.retrieveDoc","{\"_local_seq\":8,\"age\":76,\"height\":184,\"name\":\"Kermit Byrd\"}",&couchRetrieveDocument);
+defineTest test_couchDocumentCache("couchdb.documentCache","cached,1,2,2,ac",&couchDocumentCache);
+defineTest test_couchDocumentCacheMissing("couchdb.documentCacheMissing","404,none,404,stored,404,1",&couchDocumentCacheMissing);
+defineTest test_couchAccessLog("couchdb.accessLog","3,hot,3,3,1",&couchAccessLog);
+defineTest test_couchCachePolicy("couchdb.cachePolicy","0,0,1 1,0,1 1,1,1 2,1,1 2,1,2 3,1,2 3,2,2 ",&couchCachePolicy);
+defineTest test_couchStaleCanceled("couchdb.staleCanceled","1,deadline,ok",&couchStaleCanceled);
 defineTest test_couchCaching("couchdb.caching","Kermit Byrd,76,184 Owen Dillard,80,151 Nicole Jordan,75,150 Kermit Byrd,184,100 Owen Dillard,151,100 Nicole Jordan,150,100 Kermit Byrd,100,100 Owen Dillard,100,100 Nicole Jordan,100,100 ",&couchCaching);
+defineTest test_couchCacheStats("couchdb.cacheStats","0,2,1,1,1,1,1,0",&couchCacheStats);
 defineTest test_couchReduce("couchdb.reduce","20:178 30:170 40:171 50:165 70:167 80:151 ",&couchReduce);
+defineTest test_couchReduceCache("couchdb.reduceCache","20:178 30:170 40:171 50:165 70:167 80:151 |12,1,1,3:6,4:1",&couchReduceCache);
 //defineTest test_couchCaching2("couchdb.caching2","Kermit Byrd,76,184 Owen Dillard,80,151 Nicole Jordan,75,150 Kermit Byrd,184,100 Owen Dillard,151,100 Nicole Jordan,150,100 Kermit Byrd,76,184 Nicole Jordan,75,150 ",&couchCaching2);
 defineTest test_couchChangesOneShot("couchdb.changesOneShot","1",&couchChangeSetOneShot);
 defineTest test_couchChangesWaiting("couchdb.changesWaiting","ok",&couchChangeSetWaitForData);